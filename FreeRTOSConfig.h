@@ -54,7 +54,6 @@
 #define configMINIMAL_STACK_SIZE		( ( unsigned short ) 512 )
 #define configTOTAL_HEAP_SIZE			( ( size_t ) 64500 )
 #define configMAX_TASK_NAME_LEN			( 16 )
-#define configUSE_TRACE_FACILITY		0
 #define configUSE_16_BIT_TICKS			0
 #define configIDLE_SHOULD_YIELD			0
 #define configUSE_MUTEXES				1
@@ -64,8 +63,84 @@
 #define configUSE_MALLOC_FAILED_HOOK	1
 #define configUSE_APPLICATION_TASK_TAG	0
 #define configUSE_COUNTING_SEMAPHORES	1
-#define configGENERATE_RUN_TIME_STATS	0
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
+#define configSUPPORT_STATIC_ALLOCATION	1
+
+/* STATIC_ALLOC=1 builds without a heap, tasks and queues then only come
+from the pools in obj_pool.c. */
+#ifndef STATIC_ALLOC
+	#define STATIC_ALLOC				0
+#endif
+#if STATIC_ALLOC
+	#define configSUPPORT_DYNAMIC_ALLOCATION	0
+#else
+	#define configSUPPORT_DYNAMIC_ALLOCATION	1
+#endif
+
+/* Hand the slots of pool tasks back once the kernel is done with them */
+#ifndef __ASSEMBLER__
+	void obj_pool_task_release( void *tcb );
+#endif
+#define portCLEAN_UP_TCB( pxTCB )		obj_pool_task_release( pxTCB )
+
+/* Run-time stats on the cycle counter (RUNTIME_STATS=1) and the scheduler
+trace ring (SCHED_TRACE=1), see sched_trace.h.  Both need the trace facility
+for the task numbers. */
+#ifndef SCHED_TRACE
+	#define SCHED_TRACE					0
+#endif
+#ifndef RUNTIME_STATS
+	#define RUNTIME_STATS				0
+#endif
+
+#if SCHED_TRACE || RUNTIME_STATS
+	#define configUSE_TRACE_FACILITY	1
+	#ifndef __ASSEMBLER__
+		#include "sched_trace.h"
+	#endif
+#else
+	#define configUSE_TRACE_FACILITY	0
+#endif
+
+#if RUNTIME_STATS
+	#define configGENERATE_RUN_TIME_STATS				1
+	#define configRUN_TIME_COUNTER_TYPE					uint64_t
+	#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	sched_trace_runtime_init()
+	#define portGET_RUN_TIME_COUNTER_VALUE()			( rdcycle() - sched_trace_runtime_base )
+#else
+	#define configGENERATE_RUN_TIME_STATS	0
+#endif
+
+#if SCHED_TRACE
+	#define traceTASK_SWITCHED_IN()		sched_trace_event( SCHED_TRACE_SWITCH_IN, ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+	#define traceTASK_SWITCHED_OUT()	sched_trace_event( SCHED_TRACE_SWITCH_OUT, ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+#endif
+
+/* Tickless idle, see vPortSuppressTicksAndSleep() in tick.c. Opt-in: with
+the Goldfish timer the tick replay compares against the clocksource
+estimate instead of RTC time, so its error turns into replayed ticks. */
+#ifndef configUSE_TICKLESS_IDLE
+	#define configUSE_TICKLESS_IDLE		0
+#endif
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP	2
+
+/* The RISC-V port does not declare the function, so do it where the kernel
+expands the macro (TickType_t is only known there). */
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )				\
+	do {																\
+		extern void vPortSuppressTicksAndSleep( TickType_t xIdleTime );	\
+		vPortSuppressTicksAndSleep( xExpectedIdleTime );				\
+	} while( 0 )
+
+/* Multi-hart builds (FREERTOS_SMP): core IDs come from tp, cross-core
+yields are SBI IPIs. See smp.c. */
+#if defined( configNUMBER_OF_CORES ) && ( configNUMBER_OF_CORES > 1 )
+	#ifndef __ASSEMBLER__
+		void vPortYieldCore( int core );
+	#endif
+	#define portGET_CORE_ID()		xGetCoreID()
+	#define portYIELD_CORE( x )		vPortYieldCore( x )
+#endif
 
 /* Assert definitions. */
 void vAssertCalled( void );
@@ -83,7 +158,8 @@ void vAssertCalled( void );
 #define configTIMER_TASK_STACK_DEPTH	( 110 )
 
 /* RISC-V definitions. */
-#define configISR_STACK_SIZE_WORDS		2048
+/* No configISR_STACK_SIZE_WORDS: the port then uses __freertos_irq_stack_top,
+which vm-guest.ld puts into the DSPM (__isr_stack_size bytes). */
 
 /* Task priorities.  Allow these to be overridden. */
 #ifndef uartPRIMARY_PRIORITY
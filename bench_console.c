@@ -0,0 +1,249 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_console.h"
+#include "riscv-virt.h"
+
+#define CTRL_C		0x03
+
+static const struct bench_param *params = NULL;
+static size_t num_params = 0;
+static struct bench_config *cur = NULL;
+static bench_run_t run_fn = NULL;
+
+static struct bench_config queue[BENCH_CONSOLE_QUEUE_LEN];
+static size_t queue_len = 0;
+
+static char line[BENCH_CONSOLE_LINE_LEN];
+static size_t line_len = 0;
+
+static int running = 0;
+static int stop = 0;
+
+/*-----------------------------------------------------------*/
+
+static inline uint64_t *field(struct bench_config *cfg, const struct bench_param *p)
+{
+	return (uint64_t *) ((uint8_t *) cfg + p->offset);
+}
+
+static const struct bench_param *find_param(const char *name)
+{
+	for(size_t i = 0; i < num_params; i++)
+		if(!strcmp(params[i].name, name))
+			return &params[i];
+
+	return NULL;
+}
+
+static void print_config(const char *tag, struct bench_config *cfg)
+{
+	char buf[160];
+	size_t len = 0;
+
+	len = fmt_snprintf(buf, sizeof(buf), "%s", tag);
+	for(size_t i = 0; i < num_params && len < sizeof(buf); i++)
+		len += fmt_snprintf(buf + len, sizeof(buf) - len, " %s=%lu",
+							params[i].name, *field(cfg, &params[i]));
+
+	vSendString(buf);
+}
+
+// Feed one received byte into the line editor, returns 1 once a line is complete
+static int line_input(char c)
+{
+	static char prev = 0;
+	int crlf = (prev == '\r' && c == '\n');
+
+	prev = c;
+
+	// Terminals send \r, \n or both
+	if(crlf)
+		return 0;
+
+	if(c == '\r' || c == '\n'){
+		vSendString("");
+		line[line_len] = '\0';
+		line_len = 0;
+		return 1;
+	}
+
+	// Backspace / DEL
+	if(c == '\b' || c == 0x7f){
+		if(line_len){
+			line_len--;
+			vSendBytes("\b \b", 3);
+		}
+		return 0;
+	}
+
+	if(line_len < BENCH_CONSOLE_LINE_LEN - 1 && c >= ' '){
+		line[line_len++] = c;
+		vSendBytes(&c, 1);
+	}
+
+	return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void cmd_help(void)
+{
+	vSendString("help | show | set <param> <value> | run | queue | list | clear | batch | stop");
+
+	for(size_t i = 0; i < num_params; i++){
+		vSendFormat("  %-9s %lu..%lu  %s", params[i].name,
+					params[i].min, params[i].max, params[i].help);
+	}
+}
+
+static void cmd_set(char *name, char *value)
+{
+	const struct bench_param *p = NULL;
+	char *end = NULL;
+	uint64_t v = 0;
+
+	if(!name || !value){
+		vSendString("usage: set <param> <value>");
+		return;
+	}
+
+	if(!(p = find_param(name))){
+		vSendString("unknown parameter, see help");
+		return;
+	}
+
+	v = strtoull(value, &end, 0);
+	if(*end != '\0' || v < p->min || v > p->max){
+		vSendString("invalid value, see help");
+		return;
+	}
+
+	*field(cur, p) = v;
+}
+
+static void do_run(const struct bench_config *cfg)
+{
+	stop = 0;
+	running = 1;
+
+	run_fn(cfg);
+
+	running = 0;
+}
+
+static void cmd_batch(void)
+{
+	for(size_t i = 0; i < queue_len && !stop; i++){
+		vSendFormat("[console] batch %lu/%lu", i + 1, queue_len);
+
+		do_run(&queue[i]);
+	}
+
+	vSendString(stop ? "[console] batch stopped" : "[console] batch done");
+	stop = 0;
+}
+
+static void execute(char *cmd)
+{
+	char buf[32];
+	char *save = NULL;
+	char *word = strtok_r(cmd, " \t", &save);
+
+	if(!word)
+		return;
+
+	if(!strcmp(word, "help")){
+		cmd_help();
+	} else if(!strcmp(word, "show")){
+		print_config("[console] config:", cur);
+	} else if(!strcmp(word, "set")){
+		char *name = strtok_r(NULL, " \t", &save);
+		cmd_set(name, strtok_r(NULL, " \t", &save));
+	} else if(!strcmp(word, "run")){
+		do_run(cur);
+		stop = 0;
+	} else if(!strcmp(word, "queue")){
+		if(queue_len < BENCH_CONSOLE_QUEUE_LEN){
+			queue[queue_len++] = *cur;
+			vSendFormat("[console] %lu queued", queue_len);
+		} else {
+			vSendString("[console] batch is full");
+		}
+	} else if(!strcmp(word, "list")){
+		for(size_t i = 0; i < queue_len; i++){
+			fmt_snprintf(buf, sizeof(buf), "[console] %lu:", i + 1);
+			print_config(buf, &queue[i]);
+		}
+	} else if(!strcmp(word, "clear")){
+		queue_len = 0;
+	} else if(!strcmp(word, "batch")){
+		cmd_batch();
+	} else if(!strcmp(word, "stop")){
+		vSendString("[console] nothing running");
+	} else {
+		vSendString("unknown command, see help");
+	}
+}
+
+/*-----------------------------------------------------------*/
+
+void bench_console_init(const struct bench_param *p, size_t num,
+						struct bench_config *cfg, bench_run_t run)
+{
+	params = p;
+	num_params = num;
+	cur = cfg;
+	run_fn = run;
+}
+
+void bench_console_loop(void)
+{
+	char c;
+
+	vSendString("[console] ready, type help");
+	vSendBytes("> ", 2);
+
+	while(1){
+		// Sleeps until the UART interrupt brings input
+		vConsoleWaitChar(&c);
+
+		if(line_input(c)){
+			execute(line);
+			vSendBytes("> ", 2);
+		}
+	}
+}
+
+int bench_console_stop_requested(void)
+{
+	char c;
+
+	while(!stop && xConsoleGetChar(&c)){
+		if(c == CTRL_C){
+			stop = 1;
+			break;
+		}
+
+		if(!line_input(c))
+			continue;
+
+		if(!strcmp(line, "stop"))
+			stop = 1;
+		else if(line[0])
+			vSendString("[console] busy, stop first");
+	}
+
+	if(stop && running)
+		vSendString("[console] stopping");
+
+	running = running && !stop;
+
+	return stop;
+}
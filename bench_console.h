@@ -0,0 +1,68 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef BENCH_CONSOLE_H_
+#define BENCH_CONSOLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Command console on the UART to reconfigure and start benchmark runs
+// without rebuilding. Commands (one per line):
+//
+//   help                  list commands and parameters
+//   show                  print the current configuration
+//   set <param> <value>   change a parameter of the current configuration
+//   run                   run the current configuration
+//   queue                 append the current configuration to the batch
+//   list                  print the batch
+//   clear                 empty the batch
+//   batch                 run every configuration of the batch in order
+//   stop                  (or Ctrl-C) abort the running run / batch
+
+#ifndef BENCH_CONSOLE_LINE_LEN
+#define BENCH_CONSOLE_LINE_LEN	80
+#endif
+
+#ifndef BENCH_CONSOLE_QUEUE_LEN
+#define BENCH_CONSOLE_QUEUE_LEN	32
+#endif
+
+// Everything a run can be configured with at runtime
+struct bench_config {
+	uint64_t rounds;
+	uint64_t pages;
+	uint64_t random;		// Random pointer chains instead of linear walks
+	uint64_t seed;			// Seed of the random chains (0 = default)
+	uint64_t print;			// Print (or record) every round
+	uint64_t interval;		// Statistics summary every N rounds (0 = only at the end)
+	uint64_t cache;			// Cache prime+probe benchmark before the TLB probe
+	uint64_t leak;			// Sequential leakage test, stops early (see leak_test.h)
+	uint64_t delta;			// Smallest difference in cycles the leakage test looks for
+};
+
+struct bench_param {
+	const char *name;
+	size_t offset;			// Of the field in struct bench_config
+	uint64_t min;
+	uint64_t max;
+	const char *help;
+};
+
+// Returns non-zero if the run was stopped
+typedef int (*bench_run_t)(const struct bench_config *cfg);
+
+// cfg is the current configuration, changed by set
+void bench_console_init(const struct bench_param *params, size_t num_params,
+						struct bench_config *cfg, bench_run_t run);
+
+// Read and execute commands forever
+void bench_console_loop(void);
+
+// Polled by runs between rounds, consumes input looking for stop / Ctrl-C
+int bench_console_stop_requested(void);
+
+#endif /* BENCH_CONSOLE_H_ */
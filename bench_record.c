@@ -0,0 +1,157 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <stddef.h>
+
+#include "bench_record.h"
+#include "riscv-virt.h"
+
+// Worst case size of a 64-bit LEB128 varint
+#define VARINT_MAX_SIZE 10
+
+static uint32_t put_varint(uint8_t *buf, uint64_t val)
+{
+	uint32_t len = 0;
+
+	while(val >= 0x80){
+		buf[len++] = (uint8_t) (val | 0x80);
+		val >>= 7;
+	}
+	buf[len++] = (uint8_t) val;
+
+	return len;
+}
+
+static inline uint64_t zigzag(int64_t val)
+{
+	return ((uint64_t) val << 1) ^ (uint64_t) (val >> 63);
+}
+
+static uint16_t fletcher16(const uint8_t *buf, uint32_t len)
+{
+	uint32_t a = 0, b = 0;
+
+	for(uint32_t i = 0; i < len; i++){
+		a = (a + buf[i]) % 255;
+		b = (b + a) % 255;
+	}
+
+	return (uint16_t) ((b << 8) | a);
+}
+
+static void send_frame(struct bench_record *rec, uint8_t type)
+{
+	uint8_t *frame = rec->frame;
+	uint16_t csum = 0;
+
+	frame[0] = BENCH_RECORD_SYNC0;
+	frame[1] = BENCH_RECORD_SYNC1;
+	frame[2] = type;
+	frame[3] = (uint8_t) rec->len;
+
+	csum = fletcher16(&frame[2], rec->len + 2);
+	frame[BENCH_RECORD_HDR_SIZE + rec->len]     = (uint8_t) csum;
+	frame[BENCH_RECORD_HDR_SIZE + rec->len + 1] = (uint8_t) (csum >> 8);
+
+	vSendBytes((const char *) frame, BENCH_RECORD_HDR_SIZE + rec->len + BENCH_RECORD_CSUM_SIZE);
+
+	rec->len = 0;
+}
+
+void bench_record_flush(struct bench_record *rec)
+{
+	if(rec->len)
+		send_frame(rec, rec->type);
+}
+
+/*-----------------------------------------------------------*/
+
+void bench_record_begin(struct bench_record *rec)
+{
+	rec->len = 0;
+	rec->type = 0;
+	rec->next_round = 0;
+	rec->prev = 0;
+	rec->total = 0;
+
+	bench_record_meta(rec, BENCH_META_VERSION, BENCH_RECORD_VERSION);
+}
+
+void bench_record_meta(struct bench_record *rec, uint64_t key, uint64_t value)
+{
+	uint8_t *payload = &rec->frame[BENCH_RECORD_HDR_SIZE];
+
+	// Keep the stream ordered
+	bench_record_flush(rec);
+
+	rec->len  = put_varint(payload, key);
+	rec->len += put_varint(payload + rec->len, value);
+	send_frame(rec, BENCH_RECORD_META);
+}
+
+void bench_record_round(struct bench_record *rec, uint64_t round, uint64_t value)
+{
+	uint8_t *payload = &rec->frame[BENCH_RECORD_HDR_SIZE];
+
+	// Start a new frame if the rounds are not consecutive anymore
+	// or the worst case encoding would not fit
+	if(rec->len && (rec->type != BENCH_RECORD_ROUNDS || round != rec->next_round ||
+	   rec->len + VARINT_MAX_SIZE > BENCH_RECORD_MAX_PAYLOAD))
+		bench_record_flush(rec);
+
+	if(!rec->len){
+		rec->type = BENCH_RECORD_ROUNDS;
+		rec->len = put_varint(payload, round);
+		rec->prev = 0;
+	}
+
+	rec->len += put_varint(payload + rec->len, zigzag((int64_t) (value - rec->prev)));
+	rec->prev = value;
+	rec->next_round = round + 1;
+	rec->total++;
+}
+
+void bench_record_task(struct bench_record *rec, uint64_t num, const char *name)
+{
+	uint8_t *payload = &rec->frame[BENCH_RECORD_HDR_SIZE];
+
+	bench_record_flush(rec);
+
+	rec->len = put_varint(payload, num);
+	while(*name && rec->len < BENCH_RECORD_MAX_PAYLOAD)
+		payload[rec->len++] = (uint8_t) *name++;
+	send_frame(rec, BENCH_RECORD_TASK);
+}
+
+void bench_record_trace(struct bench_record *rec, uint64_t cycles, uint8_t type, uint8_t arg)
+{
+	uint8_t *payload = &rec->frame[BENCH_RECORD_HDR_SIZE];
+
+	if(rec->len && (rec->type != BENCH_RECORD_TRACE ||
+	   rec->len + 2 + VARINT_MAX_SIZE > BENCH_RECORD_MAX_PAYLOAD))
+		bench_record_flush(rec);
+
+	if(!rec->len){
+		rec->type = BENCH_RECORD_TRACE;
+		rec->len = put_varint(payload, cycles);
+		rec->prev = cycles;
+	}
+
+	payload[rec->len++] = type;
+	payload[rec->len++] = arg;
+	rec->len += put_varint(payload + rec->len, zigzag((int64_t) (cycles - rec->prev)));
+	rec->prev = cycles;
+}
+
+void bench_record_end(struct bench_record *rec)
+{
+	uint8_t *payload = &rec->frame[BENCH_RECORD_HDR_SIZE];
+
+	bench_record_flush(rec);
+
+	rec->len = put_varint(payload, rec->total);
+	send_frame(rec, BENCH_RECORD_END);
+}
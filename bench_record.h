@@ -0,0 +1,84 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef BENCH_RECORD_H_
+#define BENCH_RECORD_H_
+
+#include <stdint.h>
+
+// Binary measurement record stream
+//
+// Every frame looks like this:
+//
+//   0xA5 0x5A | type | len | payload[len] | fletcher16 (LE)
+//
+// The checksum covers type, len and the payload. Text written through
+// vSendString() never contains the sync bytes, so both can share the UART.
+//
+// All integers in a payload are LEB128 varints, signed ones zigzag encoded.
+
+#define BENCH_RECORD_SYNC0			0xA5
+#define BENCH_RECORD_SYNC1			0x5A
+#define BENCH_RECORD_HDR_SIZE		4
+#define BENCH_RECORD_CSUM_SIZE		2
+#define BENCH_RECORD_MAX_PAYLOAD	255
+#define BENCH_RECORD_VERSION		1
+
+// Frame types
+//
+// META:   key, value
+// ROUNDS: first round index, then zigzag(value - previous value) for
+//         consecutive rounds until the payload ends (previous value is 0 at
+//         the start of every frame, so a damaged frame never takes down
+//         its successors)
+// END:    total number of rounds
+// TASK:   task number, then the task name (raw bytes up to the payload end)
+// TRACE:  cycle count of the first event, then type byte, argument byte
+//         and zigzag(cycles - cycles of the previous event) per event (see
+//         sched_trace.h, the first delta is relative to the frame start)
+#define BENCH_RECORD_META			0x01
+#define BENCH_RECORD_ROUNDS			0x02
+#define BENCH_RECORD_END			0x03
+#define BENCH_RECORD_TASK			0x04
+#define BENCH_RECORD_TRACE			0x05
+
+// Keys of META frames
+#define BENCH_META_VERSION			1
+#define BENCH_META_ROUNDS			2
+#define BENCH_META_PAGES			3
+#define BENCH_META_TIMER_OVERHEAD	4
+#define BENCH_META_PAGE_SIZE		5	// Of the Sv39 alias, see sv39.h
+#define BENCH_META_CLASS_BIT		6	// 1: bit 0 of every round value is its class
+
+#ifndef BENCH_RECORD_HOST
+
+struct bench_record {
+	uint8_t frame[BENCH_RECORD_HDR_SIZE + BENCH_RECORD_MAX_PAYLOAD + BENCH_RECORD_CSUM_SIZE];
+	uint32_t len;
+	uint8_t type;			// Of the frame being filled
+	uint64_t next_round;
+	uint64_t prev;
+	uint64_t total;
+};
+
+void bench_record_begin(struct bench_record *rec);
+
+void bench_record_meta(struct bench_record *rec, uint64_t key, uint64_t value);
+
+void bench_record_round(struct bench_record *rec, uint64_t round, uint64_t value);
+
+void bench_record_task(struct bench_record *rec, uint64_t num, const char *name);
+
+void bench_record_trace(struct bench_record *rec, uint64_t cycles, uint8_t type, uint8_t arg);
+
+// Send the frame being filled
+void bench_record_flush(struct bench_record *rec);
+
+void bench_record_end(struct bench_record *rec);
+
+#endif /* BENCH_RECORD_HOST */
+
+#endif /* BENCH_RECORD_H_ */
@@ -0,0 +1,186 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <string.h>
+
+#include "bench_stats.h"
+#include "riscv-virt.h"
+
+#define SUB_COUNT	(1UL << BENCH_STATS_SUB_BITS)
+
+static uint32_t bucket_index(uint64_t value)
+{
+	uint32_t msb = 0, idx = 0;
+
+	if(value < SUB_COUNT)
+		return (uint32_t) value;
+
+	msb = 63 - (uint32_t) __builtin_clzl(value);
+
+	if(msb >= BENCH_STATS_MAX_BITS)
+		return BENCH_STATS_BUCKETS - 1;
+
+	// Octave (msb - SUB_BITS + 1) plus the SUB_BITS bits below the msb
+	idx = (msb - BENCH_STATS_SUB_BITS + 1) << BENCH_STATS_SUB_BITS;
+	idx += (uint32_t) (value >> (msb - BENCH_STATS_SUB_BITS)) - SUB_COUNT;
+
+	return idx;
+}
+
+// Highest value that still falls into bucket idx
+static uint64_t bucket_upper(uint32_t idx)
+{
+	uint32_t octave = idx >> BENCH_STATS_SUB_BITS;
+	uint64_t sub = idx & (SUB_COUNT - 1);
+
+	if(!octave)
+		return sub;
+
+	return ((SUB_COUNT + sub + 1) << (octave - 1)) - 1;
+}
+
+static uint64_t isqrt(uint64_t val)
+{
+	uint64_t res = 0, bit = 1UL << 62;
+
+	while(bit > val)
+		bit >>= 2;
+
+	while(bit){
+		if(val >= res + bit){
+			val -= res + bit;
+			res = (res >> 1) + bit;
+		} else {
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return res;
+}
+
+/*-----------------------------------------------------------*/
+
+void bench_stats_reset(struct bench_stats *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->min = UINT64_MAX;
+}
+
+void bench_stats_add(struct bench_stats *st, uint64_t value)
+{
+	st->count++;
+	st->sum += value;
+	st->sum_sq += (bench_u128_t) value * value;
+
+	if(value < st->min)
+		st->min = value;
+	if(value > st->max)
+		st->max = value;
+
+	st->buckets[bucket_index(value)]++;
+}
+
+uint64_t bench_stats_percentile(const struct bench_stats *st, uint32_t permyriad)
+{
+	uint64_t rank = 0, seen = 0, val = 0;
+
+	if(!st->count)
+		return 0;
+
+	// Smallest value with at least permyriad/10000 of all samples below or equal
+	rank = (st->count * permyriad + 9999) / 10000;
+	if(!rank)
+		rank = 1;
+
+	for(uint32_t i = 0; i < BENCH_STATS_BUCKETS; i++){
+		seen += st->buckets[i];
+		if(seen >= rank){
+			val = bucket_upper(i);
+			break;
+		}
+	}
+
+	// The bucket bounds are coarser than the exact extremes
+	if(val > st->max)
+		val = st->max;
+	if(val < st->min)
+		val = st->min;
+
+	return val;
+}
+
+uint64_t bench_stats_mean(const struct bench_stats *st)
+{
+	if(!st->count)
+		return 0;
+
+	return (uint64_t) (st->sum / st->count);
+}
+
+uint64_t bench_stats_variance(const struct bench_stats *st)
+{
+	bench_u128_t n = st->count, num = 0;
+
+	if(st->count < 2)
+		return 0;
+
+	// Sample variance: (n * sum(x^2) - sum(x)^2) / (n * (n - 1))
+	num = n * st->sum_sq - st->sum * st->sum;
+	num /= n * (n - 1);
+
+	return num > UINT64_MAX ? UINT64_MAX : (uint64_t) num;
+}
+
+// Squared standard error of the mean, in 2^-32 cycles^2:
+// (n * sum(x^2) - sum(x)^2) / (n^2 * (n - 1))
+static bench_u128_t stderr_sq(const struct bench_stats *st)
+{
+	bench_u128_t n = st->count;
+
+	return ((n * st->sum_sq - st->sum * st->sum) << 32) / (n * n * (n - 1));
+}
+
+void bench_stats_welch(const struct bench_stats *a, const struct bench_stats *b, struct bench_welch *res)
+{
+	int64_t diff = 0;		// In 2^-16 cycles
+	bench_u128_t se_sq = 0;
+	uint64_t se = 0;		// In 2^-16 cycles
+
+	memset(res, 0, sizeof(*res));
+
+	if(a->count < 2 || b->count < 2)
+		return;
+
+	diff = (int64_t) ((a->sum << 16) / a->count) - (int64_t) ((b->sum << 16) / b->count);
+
+	se_sq = stderr_sq(a) + stderr_sq(b);
+	se = isqrt(se_sq > UINT64_MAX ? UINT64_MAX : (uint64_t) se_sq);
+
+	res->diff_x100 = (diff * 100) / 65536;
+	res->stderr_x100 = (se * 100) >> 16;
+
+	// Two constant samples either differ for sure or not at all
+	if(se)
+		res->t_x100 = (diff * 100) / (int64_t) se;
+	else if(diff)
+		res->t_x100 = (diff > 0) ? INT64_MAX : -INT64_MAX;
+}
+
+void bench_stats_report(const struct bench_stats *st, const char *tag)
+{
+	uint64_t mean_x100 = 0;
+
+	if(st->count)
+		mean_x100 = (uint64_t) ((st->sum * 100) / st->count);
+
+	vSendFormat("[%s] n: %lu, min: %lu, max: %lu, mean: %lu.%02lu, stddev: %lu, "
+		"p50: %lu, p90: %lu, p99: %lu, p99.9: %lu",
+		tag, st->count, st->count ? st->min : 0, st->max,
+		mean_x100 / 100, mean_x100 % 100, isqrt(bench_stats_variance(st)),
+		bench_stats_percentile(st, 5000), bench_stats_percentile(st, 9000),
+		bench_stats_percentile(st, 9900), bench_stats_percentile(st, 9990));
+}
@@ -0,0 +1,65 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef BENCH_STATS_H_
+#define BENCH_STATS_H_
+
+#include <stdint.h>
+
+// Streaming statistics over cycle counts with a fixed memory footprint
+//
+// Values go into a log-linear (HDR style) histogram: below 2^SUB_BITS every
+// value has its own bucket, above that every power of two is split into
+// 2^SUB_BITS linear buckets. The relative error of a percentile is thus at
+// most 2^-SUB_BITS. Values with more than MAX_BITS significant bits end up
+// in the last bucket (min/max/mean stay exact).
+
+#ifndef BENCH_STATS_SUB_BITS
+#define BENCH_STATS_SUB_BITS	5
+#endif
+
+#ifndef BENCH_STATS_MAX_BITS
+#define BENCH_STATS_MAX_BITS	40
+#endif
+
+#define BENCH_STATS_BUCKETS		((BENCH_STATS_MAX_BITS - BENCH_STATS_SUB_BITS + 1) << BENCH_STATS_SUB_BITS)
+
+__extension__ typedef unsigned __int128 bench_u128_t;
+
+struct bench_stats {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	bench_u128_t sum;
+	bench_u128_t sum_sq;
+	uint32_t buckets[BENCH_STATS_BUCKETS];
+};
+
+// Welch's t-test of two samples, in hundredths
+struct bench_welch {
+	int64_t diff_x100;		// mean(a) - mean(b)
+	uint64_t stderr_x100;	// Standard error of the difference
+	int64_t t_x100;
+};
+
+void bench_stats_reset(struct bench_stats *st);
+
+void bench_stats_add(struct bench_stats *st, uint64_t value);
+
+// Percentile given in parts per ten thousand, e.g. 9990 for p99.9
+uint64_t bench_stats_percentile(const struct bench_stats *st, uint32_t permyriad);
+
+uint64_t bench_stats_mean(const struct bench_stats *st);
+
+uint64_t bench_stats_variance(const struct bench_stats *st);
+
+// Needs at least two values in a and b, all zero otherwise
+void bench_stats_welch(const struct bench_stats *a, const struct bench_stats *b, struct bench_welch *res);
+
+// Print a one line summary prefixed with tag
+void bench_stats_report(const struct bench_stats *st, const char *tag);
+
+#endif /* BENCH_STATS_H_ */
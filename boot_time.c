@@ -0,0 +1,29 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "boot_time.h"
+#include "riscv-virt.h"
+
+uint64_t boot_cycles[BOOT_PHASE_NUM];
+
+static const char *phase_names[BOOT_PHASE_NUM] = {
+	[BOOT_PHASE_ISPM]	= "ispm",
+	[BOOT_PHASE_RELOC]	= "reloc",
+	[BOOT_PHASE_DATA]	= "data",
+	[BOOT_PHASE_BSS]	= "bss",
+	[BOOT_PHASE_MAIN]	= "to main",
+};
+
+void boot_time_report(void)
+{
+#if BOOT_TIME_REPORT
+	for(uint32_t i = BOOT_PHASE_START + 1; i < BOOT_PHASE_NUM; i++)
+		vSendFormat("[boot] %-8s %lu cycles", phase_names[i], boot_cycles[i] - boot_cycles[i - 1]);
+
+	vSendFormat("[boot] total    %lu cycles",
+				boot_cycles[BOOT_PHASE_MAIN] - boot_cycles[BOOT_PHASE_START]);
+#endif
+}
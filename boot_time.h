@@ -0,0 +1,40 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef BOOT_TIME_H_
+#define BOOT_TIME_H_
+
+// Boot phase timestamps
+//
+// start.S reads the cycle counter at _start and after every boot phase and
+// stores the values into boot_cycles[] once .bss is cleared, main() adds its
+// own. Each entry marks the end of its phase, START the entry into _start.
+// Also included from start.S, so only plain defines outside the guard.
+
+#ifndef BOOT_TIME_REPORT
+#define BOOT_TIME_REPORT	1
+#endif
+
+#define BOOT_PHASE_START	0
+#define BOOT_PHASE_ISPM		1	// ISPM code copied
+#define BOOT_PHASE_RELOC	2	// Image relocated to its link address
+#define BOOT_PHASE_DATA		3	// .data copied
+#define BOOT_PHASE_BSS		4	// .bss and the DSPM cleared
+#define BOOT_PHASE_MAIN		5	// Entry into main()
+#define BOOT_PHASE_NUM		6
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+extern uint64_t boot_cycles[BOOT_PHASE_NUM];
+
+// Cycles spent in every phase, needs the console
+void boot_time_report(void);
+
+#endif /* __ASSEMBLER__ */
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "riscv-virt.h"
+#include "bench_stats.h"
+#include "cache_bench.h"
+#include "obj_pool.h"
+#include "timeslice.h"
+#include "xorshift.h"
+
+// Must match the offsets in cache_access.S
+struct cache_line_head {
+	void *next_prime;
+	void *next_probe;
+	void *next_set;
+	void *next_start;
+	uint64_t latency;
+};
+
+// Head line and probe start of every set
+static struct cache_line_head *heads[CACHE_SETS];
+static void *starts[CACHE_SETS];
+
+// Per set results. They and the statistics of the whole probe over all
+// sets come from the buffer pool (obj_pool.h) for the duration of a run.
+struct cache_results {
+	uint64_t baseline[CACHE_SETS];
+	uint64_t sum[CACHE_SETS];
+	uint64_t max[CACHE_SETS];
+	uint64_t misses[CACHE_SETS];
+};
+
+_Static_assert(sizeof(struct cache_results) <= OBJ_POOL_BUF_BYTES,
+			   "the per set results do not fit into a pool buffer");
+
+/*-----------------------------------------------------------*/
+
+static inline void **line(uint8_t *base, uint64_t set, uint64_t way)
+{
+	return (void **) (base + set * CACHE_LINE_SIZE + way * CACHE_SETS * CACHE_LINE_SIZE);
+}
+
+static void build(uint8_t *base)
+{
+	uint64_t seed = 0x9E3779B97F4A7C15UL;
+	uint16_t order[CACHE_WAYS];
+
+	for(uint64_t s = 0; s < CACHE_SETS; s++){
+		for(uint64_t i = 0; i < CACHE_WAYS; i++)
+			order[i] = (uint16_t) i;
+
+		// Fisher-Yates
+		for(uint64_t i = CACHE_WAYS - 1; i > 0; i--){
+			uint64_t j = xorshift64(&seed) % (i + 1);
+			uint16_t tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+
+		for(uint64_t i = 0; i < CACHE_WAYS; i++){
+			void **cur = line(base, s, order[i]);
+			void **next = line(base, s, order[(i + 1) % CACHE_WAYS]);
+
+			cur[0] = next;		// Prime forwards
+			next[1] = cur;		// Probe backwards
+		}
+
+		heads[s] = (struct cache_line_head *) line(base, s, order[0]);
+		starts[s] = line(base, s, order[CACHE_WAYS - 1]);
+	}
+
+	// The last set links back to the first one, cache_probe() loads it
+	for(uint64_t s = 0; s < CACHE_SETS; s++){
+		heads[s]->next_set = heads[(s + 1) % CACHE_SETS];
+		heads[s]->next_start = starts[(s + 1) % CACHE_SETS];
+		heads[s]->latency = 0;
+	}
+}
+
+int cache_bench_run(uint8_t *base, uint64_t buf_size, uint64_t rounds)
+{
+	struct cache_results *res = NULL;
+	struct bench_stats *probe_stats = NULL;
+	uint64_t total = 0, lat = 0;
+
+	if(buf_size < CACHE_BENCH_BUF_SIZE){
+		vSendFormat("[cache_bench] needs %lu bytes of buffer, got %lu",
+					(uint64_t) CACHE_BENCH_BUF_SIZE, buf_size);
+		return -1;
+	}
+
+	res = obj_pool_buf_alloc();
+	probe_stats = obj_pool_buf_alloc();
+	if(!res || !probe_stats){
+		obj_pool_buf_free(res);
+		obj_pool_buf_free(probe_stats);
+		return -1;
+	}
+
+	vSendFormat("[cache_bench] %u sets, %u ways, %u byte lines, %lu rounds",
+				CACHE_SETS, CACHE_WAYS, CACHE_LINE_SIZE, rounds);
+
+	build(base);
+
+	// Hit latency: probe right after priming
+	for(uint64_t s = 0; s < CACHE_SETS; s++)
+		res->baseline[s] = UINT64_MAX;
+
+	for(uint64_t r = 0; r < CACHE_BENCH_BASELINE_ROUNDS; r++){
+		cache_prime(heads[0], CACHE_SETS, CACHE_WAYS);
+		cache_probe(heads[0], starts[0], CACHE_SETS, CACHE_WAYS);
+
+		for(uint64_t s = 0; s < CACHE_SETS; s++)
+			if(heads[s]->latency < res->baseline[s])
+				res->baseline[s] = heads[s]->latency;
+	}
+
+	for(uint64_t s = 0; s < CACHE_SETS; s++)
+		res->sum[s] = res->max[s] = res->misses[s] = 0;
+
+	bench_stats_reset(probe_stats);
+
+	for(uint64_t r = 0; r < rounds; r++){
+		cache_prime(heads[0], CACHE_SETS, CACHE_WAYS);
+
+		// Wait for the adversary to run
+		new_timeslice_ctx_swtch();
+
+		cache_probe(heads[0], starts[0], CACHE_SETS, CACHE_WAYS);
+
+		total = 0;
+		for(uint64_t s = 0; s < CACHE_SETS; s++){
+			lat = heads[s]->latency;
+
+			res->sum[s] += lat;
+			if(lat > res->max[s])
+				res->max[s] = lat;
+			if(lat * 100 > res->baseline[s] * CACHE_BENCH_MISS_PCT)
+				res->misses[s]++;
+
+			total += lat;
+		}
+
+		bench_stats_add(probe_stats, total);
+	}
+
+	for(uint64_t s = 0; s < CACHE_SETS; s++){
+		uint64_t mean_x100 = rounds ? (res->sum[s] * 100) / rounds : 0;
+
+		vSendFormat("[cache_bench] set %lu: base %lu, mean %lu.%02lu, max %lu, misses %lu/%lu",
+					s, res->baseline[s], mean_x100 / 100, mean_x100 % 100,
+					res->max[s], res->misses[s], rounds);
+	}
+
+	bench_stats_report(probe_stats, "cache_bench probe stats");
+
+	obj_pool_buf_free(res);
+	obj_pool_buf_free(probe_stats);
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef CACHE_BENCH_H_
+#define CACHE_BENCH_H_
+
+#include <stdint.h>
+
+// Cache prime+probe benchmark
+//
+// Every cache set gets an eviction set of CACHE_WAYS lines, CACHE_SETS *
+// CACHE_LINE_SIZE bytes apart. Its lines form two cyclic pointer chains
+// in random order, one for priming and the reverse one for probing, so
+// the probe does not evict its own lines. The head line of each set also
+// links to the next set and receives the measured latency, which lets
+// cache_prime() and cache_probe() in cache_access.S run through all sets
+// without touching any other memory.
+//
+// The defaults describe a 32 KiB, 8-way L1D. Set the geometry of the L2
+// (and a large enough PROBE_BUF_PAGES) to measure that one instead. As the
+// buffer is only contiguous in guest physical memory, sets spanning more
+// than a page of a physically indexed cache may alias.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE		64
+#endif
+
+#ifndef CACHE_SETS
+#define CACHE_SETS			64
+#endif
+
+#ifndef CACHE_WAYS
+#define CACHE_WAYS			8
+#endif
+
+#ifndef CACHE_BENCH_ROUNDS
+#define CACHE_BENCH_ROUNDS	1000
+#endif
+
+// Rounds without waiting for the adversary, to get the hit latency of each set
+#ifndef CACHE_BENCH_BASELINE_ROUNDS
+#define CACHE_BENCH_BASELINE_ROUNDS	100
+#endif
+
+// A probe above MISS_PCT percent of the baseline counts as (at least one) miss
+#ifndef CACHE_BENCH_MISS_PCT
+#define CACHE_BENCH_MISS_PCT	120
+#endif
+
+#if CACHE_LINE_SIZE < 40
+#error "The head line of an eviction set needs room for five words"
+#endif
+
+// Bytes of buffer needed for the configured geometry
+#define CACHE_BENCH_BUF_SIZE	(CACHE_LINE_SIZE * CACHE_SETS * CACHE_WAYS)
+
+// Prime, wait for the adversary, probe, rounds times and print the
+// per-set results. Returns -1 if the buffer is too small.
+int cache_bench_run(uint8_t *base, uint64_t buf_size, uint64_t rounds);
+
+// Implemented in cache_access.S
+void cache_prime(void *head, uint64_t num_sets, uint64_t ways);
+void cache_probe(void *head, void *start, uint64_t num_sets, uint64_t ways);
+
+#endif /* CACHE_BENCH_H_ */
@@ -0,0 +1,187 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <FreeRTOS.h>
+
+#include "clocksource.h"
+#include "goldfish_rtc.h"
+#include "riscv-virt.h"
+
+__extension__ typedef unsigned __int128 u128;
+__extension__ typedef __int128 s128;
+
+// ns = ns_base + ((cnt - cnt_base) * mult) >> 32 up to slew_end, from
+// there on the clock runs at the calibrated rate, so a late recalibration
+// cannot make the slew overshoot
+struct cs_params {
+	uint64_t cnt_base;
+	uint64_t ns_base;
+	uint64_t mult;
+	uint64_t slew_end;
+	uint64_t rate;
+};
+
+// Readers retry while seq is odd or changed under them
+static volatile uint32_t seq = 0;
+static struct cs_params params;
+
+// First calibration point, every recalibration measures the rate
+// over the whole uptime so the estimate keeps getting better
+static uint64_t ref_cnt = 0, ref_ns = 0;
+static uint64_t next_recalib_ns = 0;
+
+/*-----------------------------------------------------------*/
+
+// Bracket the (slow, trapping) RTC read by two counter reads
+static void sample(uint64_t *cnt, uint64_t *ns)
+{
+	uint64_t pre = 0, post = 0;
+
+	pre = clocksource_read();
+	*ns = goldfish_rtc_read_time(RTC_ADDR_PTR);
+	post = clocksource_read();
+
+	*cnt = pre + (post - pre) / 2;
+}
+
+static inline uint64_t project(const struct cs_params *p, uint64_t cnt)
+{
+	uint64_t slewed = cnt, ns = 0;
+
+	if(slewed - p->cnt_base > p->slew_end - p->cnt_base)
+		slewed = p->slew_end;
+
+	ns = p->ns_base + (uint64_t) (((u128) (slewed - p->cnt_base) * p->mult) >> 32);
+
+	return ns + (uint64_t) (((u128) (cnt - slewed) * p->rate) >> 32);
+}
+
+// Consistent copy of the parameters, retries while a writer is busy
+static inline void read_params(struct cs_params *p)
+{
+	uint32_t s = 0;
+
+	do {
+		s = seq;
+		__asm volatile("fence r, r" ::: "memory");
+		*p = params;
+		__asm volatile("fence r, r" ::: "memory");
+	} while((s & 1) || s != seq);
+}
+
+static void publish(const struct cs_params *p)
+{
+	seq++;
+	__asm volatile("fence w, w" ::: "memory");
+	params = *p;
+	__asm volatile("fence w, w" ::: "memory");
+	seq++;
+}
+
+/*-----------------------------------------------------------*/
+
+void clocksource_init(void)
+{
+	struct cs_params p;
+	uint64_t cnt = 0, ns = 0;
+
+	sample(&ref_cnt, &ref_ns);
+
+	do {
+		sample(&cnt, &ns);
+	} while(ns - ref_ns < CLOCKSOURCE_CALIB_NS || cnt == ref_cnt);
+
+	p.cnt_base = cnt;
+	p.ns_base = ns;
+	p.mult = (uint64_t) (((u128) (ns - ref_ns) << 32) / (cnt - ref_cnt));
+	p.rate = p.mult;
+	p.slew_end = cnt;
+
+	publish(&p);
+
+	next_recalib_ns = ns + CLOCKSOURCE_RECALIB_NS;
+}
+
+uint64_t clocksource_now_ns(void)
+{
+	struct cs_params p;
+
+	read_params(&p);
+
+	return project(&p, clocksource_read());
+}
+
+uint64_t clocksource_cnt_to_ns(uint64_t cnt)
+{
+	struct cs_params p;
+
+	read_params(&p);
+
+	return (uint64_t) (((u128) cnt * p.rate) >> 32);
+}
+
+uint64_t clocksource_ns_to_cnt(uint64_t ns)
+{
+	struct cs_params p;
+
+	read_params(&p);
+
+	return (uint64_t) (((u128) ns << 32) / p.rate);
+}
+
+// Must run with interrupts disabled
+static void recalibrate(void)
+{
+	struct cs_params p;
+	uint64_t cnt = 0, ns = 0, rate = 0, cur = 0, interval = 0;
+	s128 err = 0, mult = 0;
+
+	sample(&cnt, &ns);
+
+	// Rate over the whole time since boot
+	rate = (uint64_t) (((u128) (ns - ref_ns) << 32) / (cnt - ref_cnt));
+
+	// Keep the clock continuous: start the new segment where the old
+	// one is right now and slew out the offset error over one
+	// recalibration interval instead of stepping (which could go
+	// backwards). Afterwards the clock runs at the plain rate again,
+	// even if the next recalibration comes late.
+	cur = project(&params, cnt);
+	err = (s128) ns - (s128) cur;
+	interval = (uint64_t) (((u128) CLOCKSOURCE_RECALIB_NS << 32) / rate);
+
+	mult = (s128) rate;
+	if(interval)
+		mult += err * ((s128) 1 << 32) / (s128) interval;
+
+	// Never slew faster than half/double speed
+	if(mult < (s128) (rate / 2))
+		mult = rate / 2;
+	if(mult > (s128) rate * 2)
+		mult = (s128) rate * 2;
+
+	p.cnt_base = cnt;
+	p.ns_base = cur;
+	p.mult = (uint64_t) mult;
+	p.rate = rate;
+	p.slew_end = cnt + interval;
+	publish(&p);
+
+	next_recalib_ns = ns + CLOCKSOURCE_RECALIB_NS;
+}
+
+void clocksource_recalibrate(void)
+{
+	portENTER_CRITICAL();
+	recalibrate();
+	portEXIT_CRITICAL();
+}
+
+void clocksource_poll(uint64_t now_ns)
+{
+	if(now_ns >= next_recalib_ns)
+		recalibrate();
+}
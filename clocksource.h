@@ -0,0 +1,63 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef CLOCKSOURCE_H_
+#define CLOCKSOURCE_H_
+
+#include <stdint.h>
+
+// Trap-free wall clock
+//
+// Reads come from the time CSR (or the cycle CSR with CLOCKSOURCE_USE_CYCLE)
+// and are scaled to Goldfish RTC nanoseconds. The scale is calibrated
+// against the RTC at boot and refined on every recalibration, which is the
+// only time the RTC is accessed.
+
+// Length of the initial calibration window
+#ifndef CLOCKSOURCE_CALIB_NS
+#define CLOCKSOURCE_CALIB_NS	10000000UL
+#endif
+
+// Interval between recalibrations
+#ifndef CLOCKSOURCE_RECALIB_NS
+#define CLOCKSOURCE_RECALIB_NS	1000000000UL
+#endif
+
+// Busy waits CLOCKSOURCE_CALIB_NS on the RTC
+void clocksource_init(void);
+
+// Current RTC time in ns, without touching the RTC
+uint64_t clocksource_now_ns(void);
+
+// Convert durations between counter ticks and ns with the calibrated rate,
+// without the slew of the offset correction
+uint64_t clocksource_cnt_to_ns(uint64_t cnt);
+uint64_t clocksource_ns_to_cnt(uint64_t ns);
+
+// Resample the RTC and refine scale and offset (task context)
+void clocksource_recalibrate(void);
+
+// Recalibrate if the last calibration is older than CLOCKSOURCE_RECALIB_NS,
+// only to be called with interrupts disabled (e.g. from the tick interrupt)
+void clocksource_poll(uint64_t now_ns);
+
+// Raw counter backing the clocksource
+static inline uint64_t clocksource_read(void)
+{
+	uint64_t cnt = 0;
+	__asm volatile(
+#ifdef CLOCKSOURCE_USE_CYCLE
+		"csrrs %0, cycle, x0\n"
+#else
+		"csrrs %0, time, x0\n"
+#endif
+		: "=r"(cnt)
+		::
+	);
+	return cnt;
+}
+
+#endif /* CLOCKSOURCE_H_ */
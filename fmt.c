@@ -0,0 +1,248 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fmt.h"
+
+// Two decimal digits per division, the compiler turns / 100 into a multiply
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+#define PAD_CHUNK	16
+
+static const char spaces[PAD_CHUNK + 1] = "                ";
+static const char zeros[PAD_CHUNK + 1] = "0000000000000000";
+
+struct fmt_out {
+	fmt_sink_t sink;
+	void *ctx;
+	size_t total;
+};
+
+static void emit(struct fmt_out *out, const char *s, size_t len)
+{
+	if(!len)
+		return;
+
+	out->sink(out->ctx, s, len);
+	out->total += len;
+}
+
+static void pad(struct fmt_out *out, const char *fill, size_t len)
+{
+	while(len > PAD_CHUNK){
+		emit(out, fill, PAD_CHUNK);
+		len -= PAD_CHUNK;
+	}
+	emit(out, fill, len);
+}
+
+// Both write backwards from end and return the first digit
+static char *u64_dec(char *end, uint64_t v)
+{
+	while(v >= 100){
+		uint64_t q = v / 100;
+		uint32_t r = (uint32_t) (v - q * 100);
+
+		end -= 2;
+		memcpy(end, &digit_pairs[r * 2], 2);
+		v = q;
+	}
+
+	if(v >= 10){
+		end -= 2;
+		memcpy(end, &digit_pairs[v * 2], 2);
+	} else {
+		*--end = (char) ('0' + v);
+	}
+
+	return end;
+}
+
+static char *u64_hex(char *end, uint64_t v, const char *digits)
+{
+	do {
+		*--end = digits[v & 0xf];
+		v >>= 4;
+	} while(v);
+
+	return end;
+}
+
+size_t fmt_vformat(fmt_sink_t sink, void *ctx, const char *fmt, va_list ap)
+{
+	struct fmt_out out = { .sink = sink, .ctx = ctx, .total = 0 };
+	const char *lit = fmt, *spec = NULL, *s = NULL, *prefix = NULL;
+	char tmp[24], *end = tmp + sizeof(tmp);
+	size_t width = 0, len = 0, prefix_len = 0, fill = 0;
+	int left = 0, zero = 0, lng = 0;
+	uint64_t u = 0;
+	int64_t v = 0;
+
+	while(*fmt){
+		if(*fmt != '%'){
+			fmt++;
+			continue;
+		}
+
+		emit(&out, lit, (size_t) (fmt - lit));
+		spec = fmt++;
+
+		left = zero = lng = 0;
+		for(;; fmt++){
+			if(*fmt == '-')
+				left = 1;
+			else if(*fmt == '0')
+				zero = 1;
+			else
+				break;
+		}
+
+		width = 0;
+		while(*fmt >= '0' && *fmt <= '9')
+			width = width * 10 + (size_t) (*fmt++ - '0');
+
+		// Everything up to int is promoted anyway, size_t is a long on LP64
+		while(*fmt == 'h')
+			fmt++;
+		while(*fmt == 'l' || *fmt == 'z'){
+			lng = 1;
+			fmt++;
+		}
+
+		end = tmp + sizeof(tmp);
+		prefix = NULL;
+		prefix_len = 0;
+
+		switch(*fmt){
+			case 'd':
+			case 'i':
+				v = lng ? va_arg(ap, long) : va_arg(ap, int);
+				u = (v < 0) ? -(uint64_t) v : (uint64_t) v;
+				if(v < 0){
+					prefix = "-";
+					prefix_len = 1;
+				}
+				s = u64_dec(end, u);
+				len = (size_t) (end - s);
+				break;
+			case 'u':
+				u = lng ? va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
+				s = u64_dec(end, u);
+				len = (size_t) (end - s);
+				break;
+			case 'x':
+			case 'X':
+				u = lng ? va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
+				s = u64_hex(end, u, (*fmt == 'x') ? hex_lower : hex_upper);
+				len = (size_t) (end - s);
+				break;
+			case 'p':
+				u = (uintptr_t) va_arg(ap, void *);
+				s = u64_hex(end, u, hex_lower);
+				len = (size_t) (end - s);
+				prefix = "0x";
+				prefix_len = 2;
+				break;
+			case 'c':
+				tmp[0] = (char) va_arg(ap, int);
+				s = tmp;
+				len = 1;
+				zero = 0;
+				break;
+			case 's':
+				s = va_arg(ap, const char *);
+				if(!s)
+					s = "(null)";
+				len = strlen(s);
+				zero = 0;
+				break;
+			case '%':
+				s = "%";
+				len = 1;
+				width = 0;
+				break;
+			default:
+				// Unknown or truncated, print it as is
+				if(*fmt)
+					fmt++;
+				emit(&out, spec, (size_t) (fmt - spec));
+				lit = fmt;
+				continue;
+		}
+
+		fmt++;
+		lit = fmt;
+
+		fill = (width > len + prefix_len) ? width - len - prefix_len : 0;
+
+		if(!left && !zero)
+			pad(&out, spaces, fill);
+		emit(&out, prefix, prefix_len);
+		if(!left && zero)
+			pad(&out, zeros, fill);
+		emit(&out, s, len);
+		if(left)
+			pad(&out, spaces, fill);
+	}
+
+	emit(&out, lit, (size_t) (fmt - lit));
+
+	return out.total;
+}
+
+/*-----------------------------------------------------------*/
+
+struct fmt_buf {
+	char *buf;
+	size_t size;
+	size_t pos;
+};
+
+static void buf_sink(void *ctx, const char *s, size_t len)
+{
+	struct fmt_buf *b = (struct fmt_buf *) ctx;
+
+	// Keep one byte for the terminator
+	if(b->pos + 1 >= b->size)
+		return;
+
+	if(len > b->size - 1 - b->pos)
+		len = b->size - 1 - b->pos;
+
+	memcpy(b->buf + b->pos, s, len);
+	b->pos += len;
+}
+
+size_t fmt_snprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	struct fmt_buf b = { .buf = buf, .size = size, .pos = 0 };
+	va_list ap;
+	size_t len = 0;
+
+	va_start(ap, fmt);
+	len = fmt_vformat(buf_sink, &b, fmt, ap);
+	va_end(ap);
+
+	if(size)
+		buf[b.pos] = '\0';
+
+	return len;
+}
@@ -0,0 +1,32 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef FMT_H_
+#define FMT_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+
+// Minimal printf-style formatter
+//
+// Allocation free and without locale or reentrancy state, so it does not
+// drag the newlib stdio into the image. Supported are %d, %i, %u, %x, %X,
+// %c, %s, %p and %%, with the flags '-' and '0', a field width and the
+// length modifiers h, hh, l, ll and z. Everything else is printed verbatim.
+
+#define FMT_PRINTF(fmt_idx, arg_idx)	__attribute__((format(printf, fmt_idx, arg_idx)))
+
+// Receives the output piece by piece
+typedef void (*fmt_sink_t)(void *ctx, const char *s, size_t len);
+
+// Returns the number of characters produced
+size_t fmt_vformat(fmt_sink_t sink, void *ctx, const char *fmt, va_list ap);
+
+// Like snprintf(), always terminates buf if size > 0 and returns the
+// length the output would have had
+size_t fmt_snprintf(char *buf, size_t size, const char *fmt, ...) FMT_PRINTF(3, 4);
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://www.github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Heap "port" for STATIC_ALLOC=1 builds.  The kernel is built without
+ * configSUPPORT_DYNAMIC_ALLOCATION and all objects come from obj_pool.c, so
+ * nothing should ever get here.  Anything that still calls pvPortMalloc()
+ * ends up in vApplicationMallocFailedHook().
+ */
+
+#include <FreeRTOS.h>
+
+#if ( configSUPPORT_DYNAMIC_ALLOCATION != 0 )
+	#error heap_none.c is only meant for builds without dynamic allocation
+#endif
+
+void *pvPortMalloc( size_t xWantedSize )
+{
+	( void ) xWantedSize;
+
+	#if ( configUSE_MALLOC_FAILED_HOOK == 1 )
+	{
+		extern void vApplicationMallocFailedHook( void );
+		vApplicationMallocFailedHook();
+	}
+	#endif
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+void vPortFree( void *pv )
+{
+	/* Nothing was ever handed out */
+	configASSERT( pv == NULL );
+}
+/*-----------------------------------------------------------*/
+
+size_t xPortGetFreeHeapSize( void )
+{
+	return 0;
+}
@@ -11,137 +11,566 @@
 #include <task.h>
 #include <queue.h>
 
-#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 
 #include "riscv-virt.h"
 #include "ns16550.h"
 #include "goldfish_rtc.h"
+#include "bench_console.h"
+#include "bench_record.h"
+#include "bench_stats.h"
+#include "cache_bench.h"
+#include "leak_test.h"
+#include "obj_pool.h"
+#include "pmu.h"
+#include "sched_bench.h"
+#include "smp.h"
+#include "sv39.h"
+#include "timeslice.h"
+#include "tlb_probe.h"
+#include "trap_bench.h"
+#include "ubench.h"
+#include "vendor_csr.h"
 
 /* Priorities used by the tasks. */
 #define PROBE_TASK_PRIO	( tskIDLE_PRIORITY )
 
+#ifndef NUM_TLB_ENTRIES
 #define NUM_TLB_ENTRIES 64
+#endif
+
+// Usable pages of the probe buffer
+#ifndef PROBE_BUF_PAGES
+#define PROBE_BUF_PAGES NUM_TLB_ENTRIES
+#endif
+
+// Measure the TLB geometry first and probe with the detected capacity
+// instead of NUM_TLB_ENTRIES (needs PROBE_BUF_PAGES > capacity)
+#ifndef TLB_SWEEP
+#define TLB_SWEEP 0
+#endif
+
+// Prime and probe with random pointer chains instead of linear walks
+#ifndef TLB_PROBE_RANDOM
+#define TLB_PROBE_RANDOM 0
+#endif
+
+// Run the cache prime+probe benchmark (see cache_bench.h) before the TLB probe
+#ifndef CACHE_BENCH
+#define CACHE_BENCH 0
+#endif
+
+// Count instructions, TLB and cache misses of every probe next to the
+// cycles (see pmu.h), needs the SBI PMU extension
+#ifndef BENCH_PMU
+#define BENCH_PMU 0
+#endif
+
+#ifndef NUM_TEST_ROUNDS
 #define NUM_TEST_ROUNDS 10000
-#define TIMESLICE_THRESH 1000000
+#endif
+
+// Print every single round. With this disabled only the statistics
+// summaries are printed, which allows for runs of millions of rounds.
+#ifndef BENCH_PRINT_ROUNDS
+#define BENCH_PRINT_ROUNDS 1
+#endif
+
+// Print an intermediate statistics summary every N rounds (0 = only at the end)
+#ifndef BENCH_STATS_INTERVAL
+#define BENCH_STATS_INTERVAL 0
+#endif
+
+// Run the micro-benchmarks (see ubench.h) before the probe
+#ifndef UBENCH
+#define UBENCH 0
+#endif
+
+// Interleave rounds with and without waiting for the adversary and stop as
+// soon as a t-test (see leak_test.h) tells whether the probe sees the
+// difference. Baseline rounds probe right after the prime, as the guest
+// cannot pause the adversary.
+#ifndef LEAK_TEST
+#define LEAK_TEST 0
+#endif
+
+// Smallest difference of the mean probe time (in cycles) that counts
+#ifndef LEAK_TEST_DELTA
+#define LEAK_TEST_DELTA 2
+#endif
+
+#define CLASS_SWITCH	0
+#define CLASS_BASELINE	1
+
+// Every online secondary hart (NUM_HARTS > 1, see smp.h) times walks over
+// a buffer of its own while the probe runs, as parallel load on the other
+// vCPUs. Off by default, the load adds cross-core contention to the probe.
+#ifndef SMP_PROBE
+#define SMP_PROBE 0
+#endif
+
+// Pages each secondary hart walks
+#ifndef SMP_PROBE_PAGES
+#define SMP_PROBE_PAGES 16
+#endif
+
+// Emit compact binary records (see bench_record.h) instead of one
+// formatted text line per round
+#ifndef BENCH_BINARY_RECORDS
+#define BENCH_BINARY_RECORDS 1
+#endif
+
+// Run the configuration above right after boot
+#ifndef BENCH_AUTORUN
+#define BENCH_AUTORUN 1
+#endif
+
+// Afterwards take commands from the UART (see bench_console.h)
+#ifndef BENCH_CONSOLE
+#define BENCH_CONSOLE 1
+#endif
+
+// Rounds between two checks for a stop command
+#ifndef BENCH_CONSOLE_POLL_ROUNDS
+#define BENCH_CONSOLE_POLL_ROUNDS 256
+#endif
 
 /*-----------------------------------------------------------*/
 
-static uint8_t shmem[4096*(NUM_TLB_ENTRIES+1)];
+// Not cleared at boot, probe_mem() zeroes the pages on their first use
+static NOINIT uint8_t shmem[4096*(PROBE_BUF_PAGES+1)];
+static uint64_t shmem_pages_ready = 0;
+
+// Where the probes access the buffer, its Sv39 alias with SV39=1
+static uint8_t *probe_base = NULL;
+
+// Rounds the rdcycle() pair of the probe is timed for timer_overhead
+#define TIMER_OVERHEAD_ROUNDS	256
+
+static uint64_t timer_overhead = 0;
+
+// From the buffer pool (obj_pool.h) while a probe runs
+static struct bench_stats *stats = NULL;
+
+static struct leak_test leak;
+
+#if SMP_PROBE && NUM_HARTS > 1
+struct smp_probe {
+	uint8_t *mem;
+	uint64_t num_pages;
+	struct bench_stats stats;
+};
+
+static struct smp_probe smp_probes[NUM_HARTS];
+
+// Disjoint from shmem, one slice per secondary. The walks only touch the
+// pages, so they never need to be cleared.
+static NOINIT uint8_t smp_mem[4096*((NUM_HARTS-1)*SMP_PROBE_PAGES+1)];
+static volatile uint32_t smp_probe_stop = 0;
+#endif
+
+#if BENCH_BINARY_RECORDS
+static struct bench_record rec;
+#endif
+
+// The build time settings are only the defaults now
+static struct bench_config config = {
+	.rounds = NUM_TEST_ROUNDS,
+	.pages = NUM_TLB_ENTRIES,
+	.random = TLB_PROBE_RANDOM,
+	.seed = 0,
+	.print = BENCH_PRINT_ROUNDS,
+	.interval = BENCH_STATS_INTERVAL,
+	.cache = CACHE_BENCH,
+	.leak = LEAK_TEST,
+	.delta = LEAK_TEST_DELTA,
+};
+
+#if BENCH_CONSOLE
+static const struct bench_param params[] = {
+	{ "rounds",   offsetof(struct bench_config, rounds),   1, UINT64_MAX,      "test rounds" },
+	{ "pages",    offsetof(struct bench_config, pages),    1, PROBE_BUF_PAGES, "pages to prime and probe" },
+	{ "random",   offsetof(struct bench_config, random),   0, 1,               "random chains instead of linear walks" },
+	{ "seed",     offsetof(struct bench_config, seed),     0, UINT64_MAX,      "seed of the random chains" },
+	{ "print",    offsetof(struct bench_config, print),    0, 1,               "output every round" },
+	{ "interval", offsetof(struct bench_config, interval), 0, UINT64_MAX,      "stats summary every N rounds" },
+	{ "cache",    offsetof(struct bench_config, cache),    0, 1,               "cache prime+probe first" },
+	{ "leak",     offsetof(struct bench_config, leak),     0, 1,               "t-test against baseline, stop early" },
+	{ "delta",    offsetof(struct bench_config, delta),    1, UINT64_MAX,      "leak test: smallest difference" },
+};
+#endif
+
+#if BENCH_PMU
+static struct pmu_group pmu;
+static struct bench_stats *pmu_stats[PMU_MAX_EVENTS];
+#endif
 
 extern void tlb_access(void *base, uint64_t num_pages, uint64_t descending);
 
+#if UBENCH
+static struct device uart = { .addr = NS16550_ADDR };
+#endif
+
 /*-----------------------------------------------------------*/
 
-static inline uint64_t rdcycle(void)
+#if BENCH_PMU
+static void pmu_add(uint64_t event, const char *name)
 {
-	uint64_t cyc = 0;
-	__asm volatile(
-		"csrrs %0, cycle, x0\n"
-		: "=r"(cyc)
-		::
-	);
-	return cyc;
+	struct bench_stats *st = obj_pool_buf_alloc();
+
+	if(!st)
+		return;
+
+	if(pmu_group_add(&pmu, event, name)){
+		vSendFormat("[pmu] %s not available", name);
+		obj_pool_buf_free(st);
+		return;
+	}
+
+	bench_stats_reset(st);
+	pmu_stats[pmu.num - 1] = st;
 }
 
-static inline uint64_t read_ctxt_swtch(void)
+static void pmu_setup(void)
+{
+	if(!pmu_init()){
+		vSendString("[pmu] No SBI PMU extension");
+		return;
+	}
+
+	pmu_add(PMU_EV_INSTRET, "pmu instret");
+	pmu_add(PMU_EV_DTLB_MISS, "pmu dtlb miss");
+	pmu_add(PMU_EV_L1D_MISS, "pmu l1d miss");
+	pmu_add(PMU_EV_LL_MISS, "pmu ll miss");
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+// Page aligned probe buffer with at least num_pages zeroed. Besides defined
+// contents this makes sure the hypervisor has mapped the pages before
+// anything is timed. Returns the address the probes use.
+static uint8_t *probe_mem(uint64_t num_pages)
 {
-	uint64_t cyc = 0;
-	__asm volatile(
-		"csrrs %0, 0x5DB, x0\n"
-		: "=r"(cyc)
-		::
-	);
-	return cyc & 1;
+	uint8_t *mem = (uint8_t *) (((uint64_t) shmem + 4095) & ~4095);
+
+	if(num_pages > shmem_pages_ready){
+		memset(mem + 4096 * shmem_pages_ready, 0, 4096 * (num_pages - shmem_pages_ready));
+		shmem_pages_ready = num_pages;
+	}
+
+	if(!probe_base)
+		probe_base = sv39_map_alias(mem, 4096 * PROBE_BUF_PAGES);
+
+	return probe_base;
 }
 
-static __attribute__((noinline)) void new_timeslice_rdcycle(void)
+#if SMP_PROBE && NUM_HARTS > 1
+// Runs bare-metal on a secondary hart until the probe is done
+static void smp_probe_job(void *arg)
 {
-	uint64_t first = 0, second = 0;
+	struct smp_probe *p = (struct smp_probe *) arg;
+	uint64_t pre_time = 0;
 
-	first = rdcycle();
-	while(1) {
-		second = rdcycle();
+	bench_stats_reset(&p->stats);
 
-		if(second-first > TIMESLICE_THRESH)
-			return;
+	while(!smp_probe_stop){
+		tlb_access(p->mem, p->num_pages, 0);
 
-		first = second;
+		pre_time = rdcycle();
+		tlb_access(p->mem, p->num_pages, 1);
+		bench_stats_add(&p->stats, rdcycle() - pre_time);
 	}
 }
 
-static __attribute__((noinline)) void new_timeslice_ctx_swtch(void)
+static void smp_probe_start(uint64_t num_pages)
 {
-	__asm volatile (
-		"csrrsi x0, 0x5DB, 2\n"
-		:::
-	);
+	// The secondaries run untranslated, so never the Sv39 alias
+	uint8_t *mem = (uint8_t *) (((uint64_t) smp_mem + 4095) & ~4095);
+
+	if(num_pages > SMP_PROBE_PAGES)
+		num_pages = SMP_PROBE_PAGES;
+
+	smp_probe_stop = 0;
 
-	while(!read_ctxt_swtch()){}
+	for(uint64_t hart = 0; hart < NUM_HARTS; hart++){
+		if(hart == (uint64_t) xGetCoreID())
+			continue;
 
-	__asm volatile (
-		"csrrw x0, 0x5DB, x0\n"
-		:::
-	);
+		smp_probes[hart].mem = mem;
+		smp_probes[hart].num_pages = num_pages;
+		smp_run_on(hart, smp_probe_job, &smp_probes[hart]);
+
+		mem += 4096 * SMP_PROBE_PAGES;
+	}
 }
 
-/*-----------------------------------------------------------*/
+static void smp_probe_finish(void)
+{
+	char tag[24];
 
-static void probe_task( void *pvParameters )
+	smp_probe_stop = 1;
+
+	for(uint64_t hart = 0; hart < NUM_HARTS; hart++){
+		if(hart == (uint64_t) xGetCoreID() || !(smp_online_mask() & (1UL << hart)))
+			continue;
+
+		smp_wait(hart);
+
+		fmt_snprintf(tag, sizeof(tag), "smp_probe hart %lu", hart);
+		bench_stats_report(&smp_probes[hart].stats, tag);
+	}
+}
+#endif
+
+// One benchmark run, returns non-zero if it was stopped from the console
+static int probe_run(const struct bench_config *cfg)
 {
-	char buf[256];
+#if !BENCH_BINARY_RECORDS
+	uint64_t prev_diff = 0;
+#endif
 	uint64_t pre_time = 0, post_time = 0;
-	uint64_t diff = 0, prev_diff = 0;
-	uint8_t *mem = (uint8_t *) (((uint64_t) shmem + 4095) & ~4095);
-
-	(void) pvParameters;
+#if BENCH_PMU
+	uint64_t pmu_pre[PMU_MAX_EVENTS], pmu_post[PMU_MAX_EVENTS];
+#endif
+	uint64_t diff = 0;
+	uint64_t num_pages = cfg->pages;
+	// Chains and the cache benchmark spread over the whole buffer
+	uint8_t *mem = probe_mem((cfg->random || cfg->cache) ? PROBE_BUF_PAGES : num_pages);
+	void *prime_head = NULL, *probe_head = NULL;
+	uint32_t cls = CLASS_SWITCH;
+	int stopped = 0;
 
 	vSendString("[probe_task] Starting");
 
-	for(int i = 0; i < NUM_TEST_ROUNDS; i++){
+	if(cfg->cache)
+		cache_bench_run(mem, 4096 * PROBE_BUF_PAGES, CACHE_BENCH_ROUNDS);
+
+	if(cfg->random){
+		struct tlb_probe_cfg chain = {
+			.base = mem,
+			.page_size = 4096,
+			.num_pages = num_pages,
+			.stride = 1,
+			.offset = 0,
+			.offset_step = 64,
+			.pattern = TLB_PATTERN_RANDOM,
+			.seed = cfg->seed,
+			.reverse = 0,
+		};
+		prime_head = tlb_probe_build(&chain, PROBE_BUF_PAGES);
+
+		// Probe in the reverse order of the prime, for the same reason the
+		// linear walks go ascending first and descending second. The second
+		// chain uses the next word of each page.
+		chain.offset = sizeof(void *);
+		chain.reverse = 1;
+		probe_head = tlb_probe_build(&chain, PROBE_BUF_PAGES);
+
+		if(!prime_head || !probe_head){
+			vSendString("[probe_task] Chain does not fit the buffer");
+			return 0;
+		}
+	}
+
+	if(!(stats = obj_pool_buf_alloc()))
+		return 0;
+
+	if(cfg->leak && leak_test_reset(&leak, cfg->seed, cfg->delta)){
+		obj_pool_buf_free(stats);
+		return 0;
+	}
+
+	bench_stats_reset(stats);
+
+#if SMP_PROBE && NUM_HARTS > 1
+	smp_probe_start(num_pages);
+#endif
+
+#if BENCH_PMU
+	pmu_setup();
+#endif
+
+#if BENCH_BINARY_RECORDS
+	if(cfg->print){
+		bench_record_begin(&rec);
+		bench_record_meta(&rec, BENCH_META_ROUNDS, cfg->rounds);
+		bench_record_meta(&rec, BENCH_META_PAGES, num_pages);
+		bench_record_meta(&rec, BENCH_META_TIMER_OVERHEAD, timer_overhead);
+		if(cfg->leak)
+			bench_record_meta(&rec, BENCH_META_CLASS_BIT, 1);
+		if(sv39_alias_page_size())
+			bench_record_meta(&rec, BENCH_META_PAGE_SIZE, sv39_alias_page_size());
+	}
+#endif
+
+	for(uint64_t i = 0; i < cfg->rounds; i++){
 
 		// Prime the TLB with our mappings
 		// always in ascending order
-		tlb_access(mem, NUM_TLB_ENTRIES, 0);
+		if(cfg->random)
+			tlb_chase(prime_head, num_pages);
+		else
+			tlb_access(mem, num_pages, 0);
 
-		// Wait for the adversary to run
+		// Wait for the adversary to run, unless this is a baseline round
 		(void)new_timeslice_rdcycle;
-		new_timeslice_ctx_swtch();
+		if(cfg->leak)
+			cls = leak_test_next_class(&leak);
+		if(cls == CLASS_SWITCH)
+			new_timeslice_ctx_swtch();
 
 		// Take the before measurement
+#if BENCH_PMU
+		pmu_group_read(&pmu, pmu_pre);
+#endif
 		pre_time = rdcycle();
 
 		// Touch all pages again
 		// always in descending order, to maximize the
 		// overlap with the primed entries (no self-eviction)
-		tlb_access(mem, NUM_TLB_ENTRIES, 1);
+		if(cfg->random)
+			tlb_chase(probe_head, num_pages);
+		else
+			tlb_access(mem, num_pages, 1);
 
 		// Take the after measurement
 		post_time = rdcycle();
+#if BENCH_PMU
+		pmu_group_read(&pmu, pmu_post);
+#endif
 
 		// Send TLB dump trigger
 		// The trigger is decremented on every context switch
 		// so this sets a timeout to stop dumping once the
 		// RTOS VM is killed
-		/*__asm volatile(
-			"csrrw x0, 0x802, %0\n"
-			:: "r"(5)
-			:
-		);*/
+		//csr_tlb_dump_trigger(5);
 
 		diff = (post_time - pre_time);
 
-		if(diff >= prev_diff){
-			sprintf(buf, "cycles: %lu, diff to prev: +%lu", diff, (diff - prev_diff));
-		} else {
-			sprintf(buf, "cycles: %lu, diff to prev: -%lu", diff, (prev_diff - diff));
+		// Baseline rounds only go into the leak test
+		if(cls == CLASS_SWITCH){
+			bench_stats_add(stats, diff);
+
+#if BENCH_PMU
+			for(uint32_t e = 0; e < pmu.num; e++)
+				bench_stats_add(pmu_stats[e], pmu_post[e] - pmu_pre[e]);
+#endif
 		}
 
-		vSendString(buf);
+		if(cfg->interval && (i + 1) % cfg->interval == 0)
+			bench_stats_report(stats, "probe_task stats");
+
+		if(cfg->print){
+#if BENCH_BINARY_RECORDS
+			bench_record_round(&rec, i, cfg->leak ? (diff << 1) | cls : diff);
+#else
+			// The diff stays between rounds that waited for the adversary
+			if(cls == CLASS_BASELINE){
+				vSendFormat("baseline cycles: %lu", diff);
+			} else {
+				if(diff >= prev_diff){
+					vSendFormat("cycles: %lu, diff to prev: +%lu", diff, (diff - prev_diff));
+				} else {
+					vSendFormat("cycles: %lu, diff to prev: -%lu", diff, (prev_diff - diff));
+				}
+
+				prev_diff = diff;
+			}
+#endif
+		}
+
+		if(cfg->leak && leak_test_add(&leak, cls, diff) != LEAK_UNDECIDED)
+			break;
 
-		prev_diff = diff;
+#if BENCH_CONSOLE
+		// Outside of the timed region, every check traps into the UART model
+		if((i + 1) % BENCH_CONSOLE_POLL_ROUNDS == 0 && bench_console_stop_requested()){
+			stopped = 1;
+			break;
+		}
+#endif
 	}
 
-	vSendString("[probe_task] Done!");
+#if SMP_PROBE && NUM_HARTS > 1
+	smp_probe_finish();
+#endif
+
+#if BENCH_BINARY_RECORDS
+	if(cfg->print)
+		bench_record_end(&rec);
+#endif
+
+	bench_stats_report(stats, "probe_task stats");
+	obj_pool_buf_free(stats);
+
+	if(cfg->leak){
+		leak_test_report(&leak, "probe switch", "probe baseline");
+		leak_test_release(&leak);
+	}
+
+#if BENCH_PMU
+	for(uint32_t e = 0; e < pmu.num; e++){
+		bench_stats_report(pmu_stats[e], pmu.ctr[e].name);
+		obj_pool_buf_free(pmu_stats[e]);
+	}
+	pmu_group_release(&pmu);
+#endif
+
+	vSendString(stopped ? "[probe_task] Stopped" : "[probe_task] Done!");
+	vConsoleFlush();
+
+	return stopped;
+}
+
+#if UBENCH
+// Nothing but the loop, should come out at about a cycle
+static void ubench_empty(void *arg, uint64_t iters)
+{
+	(void) arg;
+
+	for(uint64_t i = 0; i < iters; i++)
+		__asm volatile("" ::: "memory");
+}
+
+// Linear walk over the primed pages, all TLB hits
+static void ubench_tlb_walk(void *arg, uint64_t iters)
+{
+	for(uint64_t i = 0; i < iters; i++)
+		tlb_access(arg, config.pages, 0);
+}
+
+// A trapped MMIO read of the UART line status
+static void ubench_uart_poll(void *arg, uint64_t iters)
+{
+	for(uint64_t i = 0; i < iters; i++)
+		(void) xRxReadyNS16550((struct device *) arg);
+}
+#endif
+
+static void probe_task( void *pvParameters )
+{
+	(void) pvParameters;
+
+#if TLB_SWEEP
+	struct tlb_sweep_result sweep;
+	uint8_t *mem = probe_mem(PROBE_BUF_PAGES);
+
+	tlb_probe_sweep(mem, PROBE_BUF_PAGES, &sweep);
+	if(sweep.capacity && sweep.capacity <= PROBE_BUF_PAGES)
+		config.pages = sweep.capacity;
+#endif
+
+#if BENCH_AUTORUN
+	probe_run(&config);
+#endif
+
+#if BENCH_CONSOLE
+	// Further runs are configured over the UART
+	bench_console_init(params, sizeof(params) / sizeof(params[0]), &config, probe_run);
+	bench_console_loop();
+#endif
 
 	// We finished what we wanted to do
 	// Wait for read-out of statistics
@@ -150,21 +579,55 @@ static void probe_task( void *pvParameters )
 
 /*-----------------------------------------------------------*/
 
+// Same unfenced rdcycle() pair as around the probe: a fence would flush
+// the data cache on some cores. Anything above the minimum is an
+// interrupt or a stall.
+static uint64_t rdcycle_overhead(void)
+{
+	uint64_t start = 0, end = 0, min = UINT64_MAX;
+
+	for(uint32_t i = 0; i < TIMER_OVERHEAD_ROUNDS; i++){
+		start = rdcycle();
+		end = rdcycle();
+
+		if(end - start < min)
+			min = end - start;
+	}
+
+	vSendFormat("[probe_task] timer overhead: %lu cycles", min);
+
+	return min;
+}
+
 int isolation_bench(void)
 {
 	vSendString("Starting isolation benchmark");
 
-	uint64_t cyc1 = 0, cyc2 = 0;
-	__asm volatile(
-		"csrrs %0, cycle, x0\n	\
-		 csrrs %1, cycle, x0\n"
-		 : "=r"(cyc1), "=r"(cyc2)
-		 ::
-	);
-
-	char buf[256];
-	sprintf(buf, "cyc1 = 0x%lx, cyc2 = 0x%lx, diff = 0x%lx", cyc1, cyc2, cyc2-cyc1);
-	vSendString(buf);
+	// Overhead of the probe's cycle read pair, goes into the records
+	timer_overhead = rdcycle_overhead();
+
+#if UBENCH
+	ubench_register("empty", ubench_empty, NULL);
+	ubench_register("tlb_walk", ubench_tlb_walk, probe_mem(config.pages));
+	ubench_register("uart_poll", ubench_uart_poll, &uart);
+	ubench_run_all();
+#endif
+
+	// Gap threshold of new_timeslice_rdcycle() for this platform
+	timeslice_calibrate();
+
+#if TRAP_BENCH
+	// The trap benchmark needs the scheduler for the context switch
+	obj_pool_task_create(trap_bench_task, "TrapBench", NULL, PROBE_TASK_PRIO + 1);
+#endif
+
+#if SCHED_BENCH
+	sched_bench_create_tasks();
+#endif
+
+#if TRAP_BENCH || SCHED_BENCH
+	vTaskStartScheduler();
+#endif
 
 	//xTaskCreate(probe_task, "Probe", configMINIMAL_STACK_SIZE * 2U, NULL, PROBE_TASK_PRIO, NULL);
 
@@ -0,0 +1,112 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "leak_test.h"
+#include "obj_pool.h"
+#include "riscv-virt.h"
+#include "xorshift.h"
+
+static const char *verdict_names[] = {
+	[LEAK_UNDECIDED]	= "undecided",
+	[LEAK_FOUND]		= "leak",
+	[LEAK_NONE]			= "no leak",
+};
+
+static enum leak_verdict check(struct leak_test *lt)
+{
+	struct bench_welch w;
+	uint64_t abs_t = 0, abs_diff = 0;
+
+	bench_stats_welch(lt->cls[0], lt->cls[1], &w);
+
+	abs_t = (w.t_x100 < 0) ? -(uint64_t) w.t_x100 : (uint64_t) w.t_x100;
+	abs_diff = (w.diff_x100 < 0) ? -(uint64_t) w.diff_x100 : (uint64_t) w.diff_x100;
+
+	if(abs_t >= LEAK_TEST_T_X100)
+		return LEAK_FOUND;
+
+	// The confidence interval of the difference lies within +-delta
+	if(abs_diff + (LEAK_TEST_T_X100 * w.stderr_x100) / 100 < lt->delta_x100)
+		return LEAK_NONE;
+
+	return LEAK_UNDECIDED;
+}
+
+/*-----------------------------------------------------------*/
+
+int leak_test_reset(struct leak_test *lt, uint64_t seed, uint64_t delta)
+{
+	lt->cls[0] = obj_pool_buf_alloc();
+	lt->cls[1] = obj_pool_buf_alloc();
+
+	if(!lt->cls[0] || !lt->cls[1]){
+		leak_test_release(lt);
+		return -1;
+	}
+
+	bench_stats_reset(lt->cls[0]);
+	bench_stats_reset(lt->cls[1]);
+
+	lt->delta_x100 = delta * 100;
+	lt->rng = seed ? seed : 0x9E3779B97F4A7C15UL;
+	lt->first = lt->pos = 0;
+	lt->verdict = LEAK_UNDECIDED;
+
+	return 0;
+}
+
+void leak_test_release(struct leak_test *lt)
+{
+	obj_pool_buf_free(lt->cls[0]);
+	obj_pool_buf_free(lt->cls[1]);
+	lt->cls[0] = lt->cls[1] = NULL;
+}
+
+uint32_t leak_test_next_class(struct leak_test *lt)
+{
+	if(lt->pos){
+		lt->pos = 0;
+		return !lt->first;
+	}
+
+	lt->first = xorshift64(&lt->rng) >> 63;
+	lt->pos = 1;
+
+	return lt->first;
+}
+
+enum leak_verdict leak_test_add(struct leak_test *lt, uint32_t cls, uint64_t value)
+{
+	uint64_t total = 0;
+
+	bench_stats_add(lt->cls[cls], value);
+
+	total = lt->cls[0]->count + lt->cls[1]->count;
+	if(total % LEAK_TEST_CHECK_ROUNDS ||
+	   lt->cls[0]->count < LEAK_TEST_MIN_ROUNDS || lt->cls[1]->count < LEAK_TEST_MIN_ROUNDS)
+		return LEAK_UNDECIDED;
+
+	return lt->verdict = check(lt);
+}
+
+void leak_test_report(const struct leak_test *lt, const char *name0, const char *name1)
+{
+	struct bench_welch w;
+	uint64_t abs_diff = 0, abs_t = 0;
+
+	bench_stats_welch(lt->cls[0], lt->cls[1], &w);
+	abs_diff = (w.diff_x100 < 0) ? -(uint64_t) w.diff_x100 : (uint64_t) w.diff_x100;
+	abs_t = (w.t_x100 < 0) ? -(uint64_t) w.t_x100 : (uint64_t) w.t_x100;
+
+	bench_stats_report(lt->cls[0], name0);
+	bench_stats_report(lt->cls[1], name1);
+
+	vSendFormat("[leak_test] %s after %lu rounds: diff %s%lu.%02lu +- %lu.%02lu cycles, t %s%lu.%02lu",
+				verdict_names[lt->verdict], lt->cls[0]->count + lt->cls[1]->count,
+				(w.diff_x100 < 0) ? "-" : "", abs_diff / 100, abs_diff % 100,
+				w.stderr_x100 / 100, w.stderr_x100 % 100,
+				(w.t_x100 < 0) ? "-" : "", abs_t / 100, abs_t % 100);
+}
@@ -0,0 +1,72 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef LEAK_TEST_H_
+#define LEAK_TEST_H_
+
+#include <stdint.h>
+
+#include "bench_stats.h"
+
+// Sequential leakage test with early stopping
+//
+// Rounds come in pairs of one round per class, in random order so that
+// periodic effects hit both classes alike. Every LEAK_TEST_CHECK_ROUNDS
+// rounds (once each class has LEAK_TEST_MIN_ROUNDS) Welch's t-test
+// compares the class means:
+//
+//   |t| >= LEAK_TEST_T_X100 / 100                  leak, stop
+//   |diff| + LEAK_TEST_T_X100 / 100 * stderr < delta   no difference of
+//                                                  delta cycles or more, stop
+//
+// and the run goes on otherwise. The threshold of 4.5 (as in TVLA) is
+// strict enough to keep false alarms rare despite the repeated checks.
+
+#ifndef LEAK_TEST_T_X100
+#define LEAK_TEST_T_X100		450
+#endif
+
+#ifndef LEAK_TEST_MIN_ROUNDS
+#define LEAK_TEST_MIN_ROUNDS	1000
+#endif
+
+#ifndef LEAK_TEST_CHECK_ROUNDS
+#define LEAK_TEST_CHECK_ROUNDS	256
+#endif
+
+enum leak_verdict {
+	LEAK_UNDECIDED,
+	LEAK_FOUND,
+	LEAK_NONE,		// No difference of delta cycles or more
+};
+
+struct leak_test {
+	struct bench_stats *cls[2];	// From the buffer pool (obj_pool.h)
+	uint64_t delta_x100;
+	uint64_t rng;
+	uint32_t first;				// Class that goes first in this pair
+	uint32_t pos;				// Within the pair
+	enum leak_verdict verdict;
+};
+
+// Takes the per class statistics from the buffer pool, returns -1 if it
+// is exhausted
+int leak_test_reset(struct leak_test *lt, uint64_t seed, uint64_t delta);
+
+// Hands the per class statistics back to the pool
+void leak_test_release(struct leak_test *lt);
+
+// Class (0 or 1) of the next round
+uint32_t leak_test_next_class(struct leak_test *lt);
+
+// Account a round, returns the verdict so far
+enum leak_verdict leak_test_add(struct leak_test *lt, uint32_t cls, uint64_t value);
+
+// Per class statistics, the current difference and the verdict of the last
+// check, names label the two classes
+void leak_test_report(const struct leak_test *lt, const char *name0, const char *name1);
+
+#endif /* LEAK_TEST_H_ */
@@ -26,33 +26,57 @@
 
 /* FreeRTOS kernel includes. */
 #include <FreeRTOS.h>
-#include <stdio.h>
 #include <task.h>
 
-#include "goldfish_rtc.h"
+#include "boot_time.h"
+#include "clocksource.h"
 #include "isolation_bench.h"
-
-extern void freertos_risc_v_trap_handler( void );
-extern void freertos_vector_table( void );
+#include "obj_pool.h"
+#include "sched_trace.h"
+#include "smp.h"
+#include "sv39.h"
+#include "tick.h"
+#include "trap_bench.h"
 
 void vApplicationMallocFailedHook( void );
 void vApplicationIdleHook( void );
 void vApplicationStackOverflowHook( TaskHandle_t pxTask, char *pcTaskName );
 void vApplicationTickHook( void );
-
-void vPortSetupTimerInterrupt( void );
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize );
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize );
+void vector_swi_handler( void );
 
 /*-----------------------------------------------------------*/
 
 int main( void )
 {
 	int ret = 0;
+
+	boot_cycles[ BOOT_PHASE_MAIN ] = rdcycle();
+
 	// trap handler initialization
-	__asm volatile(
-		"csrw stvec, %0\n"
-		:: "r"(freertos_risc_v_trap_handler)
-		:
-	);
+	vSetTrapMode(TRAP_VECTORED);
+
+	// No external interrupts until drivers register for them
+	plic_init();
+
+	// Console TX ring buffer and UART interrupt
+	vConsoleInit();
+
+	// How long start.S took, see boot_time.h
+	boot_time_report();
+
+	// Task, queue and buffer pools, before anything gets created
+	obj_pool_setup();
+
+	// Calibrate time/cycle CSRs against the RTC
+	clocksource_init();
+
+	// Bring up the other harts (NUM_HARTS > 1), they wait for jobs
+	smp_boot();
+
+	// Guest page tables for the probe buffer (SV39=1)
+	sv39_setup();
 
 	ret = isolation_bench();
 
@@ -74,6 +98,8 @@ void vApplicationMallocFailedHook( void )
 	to query the size of free heap space that remains (although it does not
 	provide information on how the remaining heap might be fragmented). */
 	taskDISABLE_INTERRUPTS();
+	vSendString( "[heap] out of memory" );
+	vConsoleFlush();
 	for( ;; );
 }
 /*-----------------------------------------------------------*/
@@ -110,6 +136,30 @@ void vApplicationTickHook( void )
 }
 /*-----------------------------------------------------------*/
 
+/* The idle and timer task are switched to all the time, so their TCBs go
+into the DSPM. The stacks are too large for it. */
+static DSPM_BSS StaticTask_t xIdleTaskTCB;
+static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+static DSPM_BSS StaticTask_t xTimerTaskTCB;
+static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize )
+{
+	*ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+	*ppxIdleTaskStackBuffer = uxIdleTaskStack;
+	*pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize )
+{
+	*ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+	*ppxTimerTaskStackBuffer = uxTimerTaskStack;
+	*pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+/*-----------------------------------------------------------*/
+
 void vAssertCalled( void )
 {
 volatile uint32_t ulSetTo1ToExitFunction = 0;
@@ -121,49 +171,17 @@ volatile uint32_t ulSetTo1ToExitFunction = 0;
 	}
 }
 
-extern size_t uxTimerIncrementsForOneTick;
-
-void vPortSetupTimerInterrupt( void )
-{
-	vSendString("Setting up timer interrupt...");
-
-	// Set the Goldfish RTC timer
-	uint64_t cur_time = 0, next_time = 0;
-
-	// Clear the RTC interrupt and alarm
-	goldfish_rtc_clear_alarm(RTC_ADDR_PTR);
-	goldfish_rtc_clear_interrupt(RTC_ADDR_PTR);
-
-	// Read out the current time
-	cur_time = goldfish_rtc_read_time(RTC_ADDR_PTR);
-	next_time = cur_time + uxTimerIncrementsForOneTick;
-
-	// Set alarm
-	goldfish_rtc_set_alarm(RTC_ADDR_PTR, next_time);
-
-	// Configure the PLIC - RTC is interrupt 11
-	// Priority
-	PLIC(11*4) = 1;
-
-	// Enable bit: 0 <= 11 <= 31
-	PLIC(0x2000) = (1 << 11);
-
-	// Enable RTC interrupt
-	goldfish_rtc_enable_interrupt(RTC_ADDR_PTR);
-
-	vSendString("Done");
-}
-
-// Generic interrupt handler, here taking care of the
-// Goldfish RTC interrupt and software interrupt (i.e. yield)
+// Generic interrupt handler, here taking care of software interrupts
+// (i.e. yield), the supervisor timer and external interrupts (PLIC)
 #if __riscv_xlen == 32
-void freertos_risc_v_application_interrupt_handler(uint32_t arch_scause, uint32_t arch_sepc)
+ISPM_TEXT void freertos_risc_v_application_interrupt_handler(uint32_t arch_scause, uint32_t arch_sepc)
 #else
-void freertos_risc_v_application_interrupt_handler(uint64_t arch_scause, uint64_t arch_sepc)
+ISPM_TEXT void freertos_risc_v_application_interrupt_handler(uint64_t arch_scause, uint64_t arch_sepc)
 #endif
 {
 	uint64_t scause = arch_scause, sepc = arch_sepc;
-	uint32_t irq_id = 0;
+
+	trap_bench_mark();
 
 	// Silence compiler warnings about unused variables
 	(void) sepc;
@@ -180,43 +198,34 @@ void freertos_risc_v_application_interrupt_handler(uint64_t arch_scause, uint64_
 
 	// Software interrupt means yield
 	if(scause == 1){
+		sched_trace_event(SCHED_TRACE_YIELD, 0);
 		vTaskSwitchContext();
 
-	// Was this an external interrupt?
-	} else if(scause == 9) {
-		// Claim the interrupt from the PLIC
-		irq_id = PLIC(0x200004);
-
-		if(irq_id != 11){
-			// Just say it's done and halt
-			PLIC(0x200004) = irq_id;
-			while(1){}
-
-		} else {
-			// Set the timer in the future and complete the IRQ
-			uint64_t cur_time = 0, next_time = 0;
-
-			// Clear alarm
-			goldfish_rtc_clear_alarm(RTC_ADDR_PTR);
+	// Supervisor timer interrupt, the tick of the SBI/Sstc timer backends
+	} else if(scause == 5) {
+		tick_handle_interrupt();
 
-			// Clear interrupt
-			goldfish_rtc_clear_interrupt(RTC_ADDR_PTR);
-
-			// Take care of the scheduling stuff
-			if(xTaskIncrementTick()){
-				vTaskSwitchContext();
-			}
-
-			// Read out the current time
-			cur_time = goldfish_rtc_read_time(RTC_ADDR_PTR);
-			next_time = cur_time + uxTimerIncrementsForOneTick;
-
-			// Set alarm
-			goldfish_rtc_set_alarm(RTC_ADDR_PTR, next_time);
-			PLIC(0x200004) = irq_id;
-		}
+	// External interrupts are handled by whoever registered with the PLIC
+	} else if(scause == 9) {
+		plic_dispatch();
 
 	} else {
 		while(1){};
 	}
 }
+
+// Vectored mode fast path for yields (see vector.S)
+ISPM_TEXT void vector_swi_handler(void)
+{
+	trap_bench_mark();
+
+	// Clear the SSIP bit
+	__asm volatile(
+		"csrrc x0, sip, %0"
+		:: "r"(1 << 1)
+		:
+	);
+
+	sched_trace_event(SCHED_TRACE_YIELD, 0);
+	vTaskSwitchContext();
+}
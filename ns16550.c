@@ -42,6 +42,15 @@
 #define REG_BRDL	0x00 /* Divisor latch (LSB) */
 #define REG_BRDH	0x01 /* Divisor latch (MSB) */
 
+/* Interrupt enable */
+#define IER_ERBFI		0x01 /* Received data available */
+#define IER_ETBEI		0x02 /* Transmitter holding register empty */
+
+/* FIFO control */
+#define FCR_FIFO_EN		0x01 /* Enable RX/TX FIFOs */
+#define FCR_RX_RST		0x02 /* Reset RX FIFO */
+#define FCR_TX_RST		0x04 /* Reset TX FIFO */
+
 /* Line status */
 #define LSR_DR			0x01 /* Data ready */
 #define LSR_OE			0x02 /* Overrun error */
@@ -54,12 +63,48 @@
 
 static uint8_t readb( uintptr_t addr )
 {
-	return *( (uint8_t *) addr );
+	return *( (volatile uint8_t *) addr );
 }
 
 static void writeb( uint8_t b, uintptr_t addr )
 {
-	*( (uint8_t *) addr ) = b;
+	*( (volatile uint8_t *) addr ) = b;
+}
+
+void vInitNS16550( struct device *dev )
+{
+	uintptr_t addr = dev->addr;
+
+	/* No interrupts until somebody asks for them */
+	writeb( 0, addr + REG_IER );
+
+	/* Enable and reset the FIFOs so a THRE event means there is room
+	for a whole burst of NS16550_FIFO_DEPTH bytes */
+	writeb( FCR_FIFO_EN | FCR_RX_RST | FCR_TX_RST, addr + REG_FCR );
+}
+
+int xTxEmptyNS16550( struct device *dev )
+{
+	return ( readb( dev->addr + REG_LSR ) & LSR_THRE ) != 0;
+}
+
+void vWriteNS16550( struct device *dev, unsigned char c )
+{
+	writeb( c, dev->addr + REG_THR );
+}
+
+void vEnableTxIrqNS16550( struct device *dev )
+{
+	uintptr_t addr = dev->addr;
+
+	writeb( readb( addr + REG_IER ) | IER_ETBEI, addr + REG_IER );
+}
+
+void vDisableTxIrqNS16550( struct device *dev )
+{
+	uintptr_t addr = dev->addr;
+
+	writeb( readb( addr + REG_IER ) & ~IER_ETBEI, addr + REG_IER );
 }
 
 void vOutNS16550( struct device *dev, unsigned char c )
@@ -72,3 +117,20 @@ void vOutNS16550( struct device *dev, unsigned char c )
 
 	writeb( c, addr + REG_THR );
 }
+
+int xRxReadyNS16550( struct device *dev )
+{
+	return ( readb( dev->addr + REG_LSR ) & LSR_DR ) != 0;
+}
+
+unsigned char ucReadNS16550( struct device *dev )
+{
+	return readb( dev->addr + REG_RBR );
+}
+
+void vEnableRxIrqNS16550( struct device *dev )
+{
+	uintptr_t addr = dev->addr;
+
+	writeb( readb( addr + REG_IER ) | IER_ERBFI, addr + REG_IER );
+}
@@ -29,10 +29,21 @@
 
 #include <stdint.h>
 
+/* TX FIFO depth of a 16550A, i.e. how many bytes may be written after THRE */
+#define NS16550_FIFO_DEPTH	16
+
 struct device {
 	uintptr_t addr;
 };
 
+void vInitNS16550( struct device *dev );
+int xTxEmptyNS16550( struct device *dev );
+void vWriteNS16550( struct device *dev, unsigned char c );
+void vEnableTxIrqNS16550( struct device *dev );
+void vDisableTxIrqNS16550( struct device *dev );
 void vOutNS16550( struct device *dev, unsigned char c );
+int xRxReadyNS16550( struct device *dev );
+unsigned char ucReadNS16550( struct device *dev );
+void vEnableRxIrqNS16550( struct device *dev );
 
 #endif /* NS16550_H_ */
@@ -0,0 +1,155 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "obj_pool.h"
+#include "riscv-virt.h"
+
+#if OBJ_POOL_DSPM
+#define POOL_OBJ	DSPM_BSS
+#else
+#define POOL_OBJ
+#endif
+
+// Buffers keep the 16 byte alignment of struct bench_stats (__int128)
+#define BUF_ALIGN	16
+#define BUF_SIZE	((OBJ_POOL_BUF_BYTES + BUF_ALIGN - 1) & ~((size_t) BUF_ALIGN - 1))
+
+struct queue_slot {
+	StaticQueue_t queue;
+	uint8_t storage[OBJ_POOL_QUEUE_BYTES];
+};
+
+// Task i always uses stack i, so only the TCBs need a pool
+static POOL_OBJ StaticTask_t task_tcbs[OBJ_POOL_TASKS];
+static StackType_t task_stacks[OBJ_POOL_TASKS][OBJ_POOL_STACK_WORDS];
+
+static POOL_OBJ struct queue_slot queue_slots[OBJ_POOL_QUEUES];
+
+static uint8_t bufs[OBJ_POOL_BUFS][BUF_SIZE] __attribute__((aligned(BUF_ALIGN)));
+
+static struct obj_pool task_pool;
+static struct obj_pool queue_pool;
+static struct obj_pool buf_pool;
+
+/*-----------------------------------------------------------*/
+
+void obj_pool_init(struct obj_pool *pool, const char *name, void *mem, size_t obj_size, uint32_t num)
+{
+	uint8_t *slot = (uint8_t *) mem;
+
+	pool->name = name;
+	pool->start = slot;
+	pool->end = slot + obj_size * num;
+	pool->obj_size = obj_size;
+	pool->used = pool->peak = 0;
+	pool->free = NULL;
+
+	// Link back to front, so the first allocation gets the first slot
+	for(uint32_t i = num; i > 0; i--){
+		*(void **) (slot + (i - 1) * obj_size) = pool->free;
+		pool->free = slot + (i - 1) * obj_size;
+	}
+}
+
+void *obj_pool_alloc(struct obj_pool *pool)
+{
+	void *obj = NULL;
+
+	portENTER_CRITICAL();
+
+	obj = pool->free;
+	if(obj){
+		pool->free = *(void **) obj;
+		if(++pool->used > pool->peak)
+			pool->peak = pool->used;
+	}
+
+	portEXIT_CRITICAL();
+
+	return obj;
+}
+
+void obj_pool_free(struct obj_pool *pool, void *obj)
+{
+	if(!obj_pool_owns(pool, obj))
+		return;
+
+	portENTER_CRITICAL();
+
+	*(void **) obj = pool->free;
+	pool->free = obj;
+	pool->used--;
+
+	portEXIT_CRITICAL();
+}
+
+int obj_pool_owns(const struct obj_pool *pool, const void *obj)
+{
+	const uint8_t *p = (const uint8_t *) obj;
+
+	return p >= pool->start && p < pool->end && !((size_t) (p - pool->start) % pool->obj_size);
+}
+
+void obj_pool_setup(void)
+{
+	obj_pool_init(&task_pool, "tasks", task_tcbs, sizeof(StaticTask_t), OBJ_POOL_TASKS);
+	obj_pool_init(&queue_pool, "queues", queue_slots, sizeof(struct queue_slot), OBJ_POOL_QUEUES);
+	obj_pool_init(&buf_pool, "buffers", bufs, sizeof(bufs[0]), OBJ_POOL_BUFS);
+}
+
+/*-----------------------------------------------------------*/
+
+TaskHandle_t obj_pool_task_create(TaskFunction_t fn, const char *name, void *arg, UBaseType_t prio)
+{
+	StaticTask_t *tcb = (StaticTask_t *) obj_pool_alloc(&task_pool);
+
+	if(!tcb){
+		vSendFormat("[obj_pool] no task slot left for %s", name);
+		return NULL;
+	}
+
+	return xTaskCreateStatic(fn, name, OBJ_POOL_STACK_WORDS, arg, prio,
+							 task_stacks[tcb - task_tcbs], tcb);
+}
+
+void obj_pool_task_release(void *tcb)
+{
+	obj_pool_free(&task_pool, tcb);
+}
+
+QueueHandle_t obj_pool_queue_create(UBaseType_t len, UBaseType_t item_size)
+{
+	struct queue_slot *slot = NULL;
+
+	if((size_t) len * item_size > OBJ_POOL_QUEUE_BYTES){
+		vSendFormat("[obj_pool] queue of %lu bytes does not fit into a slot",
+					(uint64_t) len * item_size);
+		return NULL;
+	}
+
+	slot = (struct queue_slot *) obj_pool_alloc(&queue_pool);
+	if(!slot){
+		vSendString("[obj_pool] no queue slot left");
+		return NULL;
+	}
+
+	return xQueueCreateStatic(len, item_size, slot->storage, &slot->queue);
+}
+
+void *obj_pool_buf_alloc(void)
+{
+	void *buf = obj_pool_alloc(&buf_pool);
+
+	if(!buf)
+		vSendString("[obj_pool] no buffer left");
+
+	return buf;
+}
+
+void obj_pool_buf_free(void *buf)
+{
+	obj_pool_free(&buf_pool, buf);
+}
@@ -0,0 +1,100 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef OBJ_POOL_H_
+#define OBJ_POOL_H_
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bench_stats.h"
+
+// Fixed-size object pools instead of the FreeRTOS heap
+//
+// Every pool is a static array of equally sized slots with an intrusive
+// free list, so allocating and freeing take constant time, nothing
+// fragments and all of the memory shows up in the link map. Tasks, queues
+// and measurement buffers have a pool each. With STATIC_ALLOC=1 the build
+// drops the heap altogether and these pools are the only allocator.
+
+// Tasks, their stacks and the size of each stack in words
+#ifndef OBJ_POOL_TASKS
+#define OBJ_POOL_TASKS			4
+#endif
+
+#ifndef OBJ_POOL_STACK_WORDS
+#define OBJ_POOL_STACK_WORDS	( configMINIMAL_STACK_SIZE * 2U )
+#endif
+
+// Queues and the storage area of each (length * item size)
+#ifndef OBJ_POOL_QUEUES
+#define OBJ_POOL_QUEUES			4
+#endif
+
+#ifndef OBJ_POOL_QUEUE_BYTES
+#define OBJ_POOL_QUEUE_BYTES	128
+#endif
+
+// Measurement buffers, each one holds a struct bench_stats. The default
+// covers a probe run: its statistics, one per PMU counter and the two
+// classes of the leak test.
+#ifndef OBJ_POOL_BUFS
+#define OBJ_POOL_BUFS			7
+#endif
+
+#ifndef OBJ_POOL_BUF_BYTES
+#define OBJ_POOL_BUF_BYTES		sizeof(struct bench_stats)
+#endif
+
+// Put the TCB and queue pools into the DSPM. The stacks and the
+// measurement buffers are always too large for it.
+#ifndef OBJ_POOL_DSPM
+#define OBJ_POOL_DSPM			0
+#endif
+
+struct obj_pool {
+	const char *name;
+	void *free;				// First free slot, its first word links to the next one
+	uint8_t *start;
+	uint8_t *end;
+	size_t obj_size;
+	uint32_t used;
+	uint32_t peak;
+};
+
+// obj_size must be a multiple of the pointer size
+void obj_pool_init(struct obj_pool *pool, const char *name, void *mem, size_t obj_size, uint32_t num);
+
+// NULL if the pool is exhausted
+void *obj_pool_alloc(struct obj_pool *pool);
+
+void obj_pool_free(struct obj_pool *pool, void *obj);
+
+int obj_pool_owns(const struct obj_pool *pool, const void *obj);
+
+// Set up the task, queue and buffer pools, before anything is created
+void obj_pool_setup(void);
+
+// Like xTaskCreate() with a stack of OBJ_POOL_STACK_WORDS. The slot goes
+// back to the pool once the kernel deleted the task (portCLEAN_UP_TCB).
+TaskHandle_t obj_pool_task_create(TaskFunction_t fn, const char *name, void *arg, UBaseType_t prio);
+
+// Called by the kernel for every deleted task, ignores TCBs from elsewhere
+void obj_pool_task_release(void *tcb);
+
+// Like xQueueCreate(), len * item_size must fit into OBJ_POOL_QUEUE_BYTES
+QueueHandle_t obj_pool_queue_create(UBaseType_t len, UBaseType_t item_size);
+
+// OBJ_POOL_BUF_BYTES of uninitialized memory, NULL if none is left
+void *obj_pool_buf_alloc(void);
+
+void obj_pool_buf_free(void *buf);
+
+#endif
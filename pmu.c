@@ -0,0 +1,122 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "pmu.h"
+#include "sbi.h"
+
+// counter_get_info: CSR number in [11:0], firmware counter if bit 63 is set
+#define CTR_INFO_CSR(info)		((info) & 0xFFF)
+#define CTR_INFO_FW(info)		((info) >> 63)
+
+static unsigned long num_counters = 0;
+
+// Counters handed out so far, so groups do not steal each other's
+static uint64_t used_mask = 0;
+
+/*-----------------------------------------------------------*/
+
+unsigned long pmu_init(void)
+{
+	struct sbiret ret;
+
+	if(!sbi_probe_extension(SBI_EXT_PMU))
+		return 0;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_PMU_NUM_COUNTERS, 0, 0, 0, 0, 0);
+	if(ret.error != SBI_SUCCESS)
+		return 0;
+
+	num_counters = (unsigned long) ret.value;
+	if(num_counters > 64)
+		num_counters = 64;
+
+	return num_counters;
+}
+
+int pmu_group_add(struct pmu_group *g, uint64_t event, const char *name)
+{
+	struct sbiret ret;
+	unsigned long mask = 0, info = 0;
+
+	if(g->num >= PMU_MAX_EVENTS || !num_counters)
+		return -1;
+
+	mask = (num_counters == 64) ? ~0UL : (1UL << num_counters) - 1;
+	mask &= ~used_mask;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_PMU_COUNTER_CONFIG_MATCHING, 0, mask,
+					SBI_PMU_CFG_FLAG_CLEAR_VALUE | SBI_PMU_CFG_FLAG_AUTO_START, event, 0);
+	if(ret.error != SBI_SUCCESS)
+		return -1;
+
+	struct pmu_counter *c = &g->ctr[g->num];
+	c->name = name;
+	c->event = event;
+	c->idx = (unsigned long) ret.value;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_PMU_COUNTER_GET_INFO, c->idx, 0, 0, 0, 0);
+	info = (unsigned long) ret.value;
+
+	// Firmware counters can only be read through the SBI, not worth it
+	// around a probe region
+	if(ret.error != SBI_SUCCESS || CTR_INFO_FW(info)){
+		sbi_ecall(SBI_EXT_PMU, SBI_PMU_COUNTER_STOP, c->idx, 1, 0, 0, 0);
+		return -1;
+	}
+
+	c->csr = CTR_INFO_CSR(info);
+	used_mask |= 1UL << c->idx;
+	g->num++;
+
+	return 0;
+}
+
+void pmu_group_release(struct pmu_group *g)
+{
+	for(uint32_t i = 0; i < g->num; i++){
+		sbi_ecall(SBI_EXT_PMU, SBI_PMU_COUNTER_STOP, g->ctr[i].idx, 1, 0, 0, 0);
+		used_mask &= ~(1UL << g->ctr[i].idx);
+	}
+
+	g->num = 0;
+}
+
+#define CASE_CSR(n)							\
+	case 0xC00 + (n):						\
+		__asm volatile(						\
+			"csrrs %0, %1, x0\n"			\
+			: "=r"(val)						\
+			: "i"(0xC00 + (n))				\
+			:								\
+		);									\
+		break
+
+uint64_t pmu_read_csr(uint32_t csr)
+{
+	uint64_t val = 0;
+
+	// The CSR number is part of the instruction
+	switch(csr){
+		CASE_CSR(0);  CASE_CSR(1);  CASE_CSR(2);  CASE_CSR(3);
+		CASE_CSR(4);  CASE_CSR(5);  CASE_CSR(6);  CASE_CSR(7);
+		CASE_CSR(8);  CASE_CSR(9);  CASE_CSR(10); CASE_CSR(11);
+		CASE_CSR(12); CASE_CSR(13); CASE_CSR(14); CASE_CSR(15);
+		CASE_CSR(16); CASE_CSR(17); CASE_CSR(18); CASE_CSR(19);
+		CASE_CSR(20); CASE_CSR(21); CASE_CSR(22); CASE_CSR(23);
+		CASE_CSR(24); CASE_CSR(25); CASE_CSR(26); CASE_CSR(27);
+		CASE_CSR(28); CASE_CSR(29); CASE_CSR(30); CASE_CSR(31);
+		default:
+			break;
+	}
+
+	return val;
+}
+
+void pmu_group_read(const struct pmu_group *g, uint64_t *vals)
+{
+	for(uint32_t i = 0; i < g->num; i++)
+		vals[i] = pmu_read_csr(g->ctr[i].csr);
+}
@@ -0,0 +1,86 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef PMU_H_
+#define PMU_H_
+
+#include <stdint.h>
+
+// Hardware performance counters
+//
+// The mhpmevent CSRs are M-mode only, so counters are programmed through
+// the SBI PMU extension, which also makes them readable from S-mode.
+// Reading goes straight to the hpmcounter CSR the SBI handed out.
+
+#define SBI_EXT_PMU						0x504D55
+
+#define SBI_PMU_NUM_COUNTERS			0
+#define SBI_PMU_COUNTER_GET_INFO		1
+#define SBI_PMU_COUNTER_CONFIG_MATCHING	2
+#define SBI_PMU_COUNTER_START			3
+#define SBI_PMU_COUNTER_STOP			4
+
+#define SBI_PMU_CFG_FLAG_CLEAR_VALUE	(1UL << 1)
+#define SBI_PMU_CFG_FLAG_AUTO_START		(1UL << 2)
+
+// Event indices of the SBI specification
+#define PMU_EVENT_HW(code)				(code)
+#define PMU_EVENT_CACHE(id, op, res)	((1UL << 16) | ((id) << 3) | ((op) << 1) | (res))
+
+#define PMU_HW_CPU_CYCLES				1
+#define PMU_HW_INSTRUCTIONS				2
+#define PMU_HW_CACHE_MISSES				4
+
+#define PMU_CACHE_L1D					0
+#define PMU_CACHE_L1I					1
+#define PMU_CACHE_LL					2
+#define PMU_CACHE_DTLB					3
+#define PMU_CACHE_ITLB					4
+
+#define PMU_OP_READ						0
+#define PMU_RESULT_ACCESS				0
+#define PMU_RESULT_MISS					1
+
+#define PMU_EV_INSTRET		PMU_EVENT_HW(PMU_HW_INSTRUCTIONS)
+#define PMU_EV_L1D_MISS		PMU_EVENT_CACHE(PMU_CACHE_L1D, PMU_OP_READ, PMU_RESULT_MISS)
+#define PMU_EV_LL_MISS		PMU_EVENT_CACHE(PMU_CACHE_LL, PMU_OP_READ, PMU_RESULT_MISS)
+#define PMU_EV_DTLB_MISS	PMU_EVENT_CACHE(PMU_CACHE_DTLB, PMU_OP_READ, PMU_RESULT_MISS)
+#define PMU_EV_ITLB_MISS	PMU_EVENT_CACHE(PMU_CACHE_ITLB, PMU_OP_READ, PMU_RESULT_MISS)
+
+// Counters sampled together around a probe region
+#ifndef PMU_MAX_EVENTS
+#define PMU_MAX_EVENTS		4
+#endif
+
+struct pmu_counter {
+	const char *name;
+	uint64_t event;
+	unsigned long idx;		// SBI counter index
+	uint32_t csr;			// hpmcounterN (or cycle/instret) CSR number
+};
+
+struct pmu_group {
+	uint32_t num;
+	struct pmu_counter ctr[PMU_MAX_EVENTS];
+};
+
+// Returns the number of counters, 0 if there is no SBI PMU
+unsigned long pmu_init(void);
+
+// Find a counter for event, program and start it. Returns -1 if the
+// event is not supported or all counters are taken.
+int pmu_group_add(struct pmu_group *g, uint64_t event, const char *name);
+
+// Stop all counters of the group and forget about them
+void pmu_group_release(struct pmu_group *g);
+
+// Read counter CSR csr (0xC00 .. 0xC1F), 0 for an unknown one
+uint64_t pmu_read_csr(uint32_t csr);
+
+// Read all counters of the group into vals[0 .. g->num - 1]
+void pmu_group_read(const struct pmu_group *g, uint64_t *vals);
+
+#endif /* PMU_H_ */
@@ -25,37 +25,486 @@
  */
 
 #include <FreeRTOS.h>
+#include <task.h>
 
+#include <stdarg.h>
 #include <string.h>
 
 #include "riscv-virt.h"
 #include "ns16550.h"
+#include "virtio_console.h"
+
+#define SSTATUS_SIE		( 1UL << 1 )
+#define SIE_SEIE		( 1UL << 9 )
 
 int xGetCoreID( void )
 {
 int id;
 
-	//__asm ("csrr %0, mhartid" : "=r" ( id ) );
-	id = 0;
+	/* start.S puts the hart ID into tp, nothing touches it afterwards */
+	__asm volatile( "mv %0, tp" : "=r" ( id ) );
 
 	return id;
 }
 
-void vSendString( const char *s )
+/*-----------------------------------------------------------*/
+
+struct plic_entry {
+	plic_handler_t handler;
+	void *arg;
+};
+
+static struct plic_entry xPlicHandlers[ PLIC_NUM_SOURCES ];
+static uint32_t ulPlicSpurious = 0;
+
+/* The priorities are shared by all harts, so only the primary hart resets
+them. Enables, threshold and claims below act on the calling hart's own
+context. */
+void plic_init( void )
+{
+uint32_t irq;
+
+	for( irq = 1; irq < PLIC_NUM_SOURCES; irq++ ) {
+		plic_set_priority( irq, 0 );
+	}
+
+	plic_init_hart();
+}
+
+/* Everything off, accept any priority > 0 */
+void plic_init_hart( void )
+{
+uint32_t irq;
+
+	for( irq = 1; irq < PLIC_NUM_SOURCES; irq++ ) {
+		plic_disable( irq );
+	}
+
+	plic_set_threshold( 0 );
+}
+
+void plic_set_priority( uint32_t irq, uint32_t priority )
+{
+	PLIC_PRIORITY( irq ) = priority;
+}
+
+void plic_set_threshold( uint32_t threshold )
+{
+	PLIC_THRESHOLD( PLIC_HART_CONTEXT( xGetCoreID() ) ) = threshold;
+}
+
+void plic_enable( uint32_t irq )
+{
+	PLIC_ENABLE( PLIC_HART_CONTEXT( xGetCoreID() ), irq ) |= ( 1U << ( irq % 32 ) );
+}
+
+void plic_disable( uint32_t irq )
+{
+	PLIC_ENABLE( PLIC_HART_CONTEXT( xGetCoreID() ), irq ) &= ~( 1U << ( irq % 32 ) );
+}
+
+int plic_register_handler( uint32_t irq, uint32_t priority, plic_handler_t handler, void *arg )
+{
+	if( ( irq == 0 ) || ( irq >= PLIC_NUM_SOURCES ) || ( priority == 0 ) ) {
+		return -1;
+	}
+
+	xPlicHandlers[ irq ].handler = handler;
+	xPlicHandlers[ irq ].arg = arg;
+
+	plic_set_priority( irq, priority );
+	plic_enable( irq );
+
+	return 0;
+}
+
+/* Claim and handle everything that is pending, so interrupts that
+arrive together only cost a single trap */
+ISPM_TEXT void plic_dispatch( void )
+{
+uint32_t irq, ctx = PLIC_HART_CONTEXT( xGetCoreID() );
+
+	while( ( irq = PLIC_CLAIM( ctx ) ) != 0 ) {
+		if( ( irq < PLIC_NUM_SOURCES ) && ( xPlicHandlers[ irq ].handler != NULL ) ) {
+			xPlicHandlers[ irq ].handler( xPlicHandlers[ irq ].arg );
+		} else {
+			/* Nobody wants it, make sure it does not come back */
+			plic_disable( irq );
+			ulPlicSpurious++;
+		}
+
+		PLIC_CLAIM( ctx ) = irq;
+	}
+}
+
+uint32_t plic_get_spurious( void )
+{
+	return ulPlicSpurious;
+}
+
+/*-----------------------------------------------------------*/
+
+/* TX ring buffer between vSendString() and the UART. The producer only
+advances uxTxHead, the consumer (THRE interrupt or a synchronous drain) only
+advances uxTxTail. */
+static char cTxBuf[ CONSOLE_TX_BUF_SIZE ];
+static volatile size_t uxTxHead = 0;
+static volatile size_t uxTxTail = 0;
+
+/* RX ring buffer, filled by the UART interrupt or, while interrupts are
+off, by xConsoleGetChar() itself. Bytes that do not fit are dropped. */
+static char cRxBuf[ CONSOLE_RX_BUF_SIZE ];
+static volatile size_t uxRxHead = 0;
+static volatile size_t uxRxTail = 0;
+
+static struct device xConsoleDev = { .addr = NS16550_ADDR };
+
+/* Task sleeping in vConsoleWaitChar() until the RX interrupt gives it a
+notification */
+static TaskHandle_t xRxWaiter = NULL;
+
+#if CONSOLE_BACKEND == CONSOLE_BACKEND_VIRTIO
+/* Set once a virtio console was found, bytes from uxTxTail on that the
+device is still reading */
+static int xTxVirtio = 0;
+static size_t uxTxInflight = 0;
+
+/* Retire the chain the device finished and hand everything that is pending
+over as the next one.  Must be called with interrupts masked. */
+static void prvTxVirtio( void )
 {
-struct device dev;
+struct virtio_buf xBufs[ 2 ];
+size_t uxHead = uxTxHead, uxTail = uxTxTail;
+uint32_t ulNum = 0;
+
+	if( uxTxInflight != 0 ) {
+		if( !virtio_console_tx_done() ) {
+			return;
+		}
+
+		uxTail = ( uxTail + uxTxInflight ) & ( CONSOLE_TX_BUF_SIZE - 1 );
+		uxTxTail = uxTail;
+		uxTxInflight = 0;
+	}
+
+	if( uxTail == uxHead ) {
+		return;
+	}
+
+	/* At most two pieces, the second one if the data wraps around */
+	xBufs[ ulNum ].addr = &cTxBuf[ uxTail ];
+	xBufs[ ulNum++ ].len = ( uxHead > uxTail ) ? ( uxHead - uxTail ) : ( CONSOLE_TX_BUF_SIZE - uxTail );
+
+	if( ( uxHead < uxTail ) && ( uxHead != 0 ) ) {
+		xBufs[ ulNum ].addr = &cTxBuf[ 0 ];
+		xBufs[ ulNum++ ].len = uxHead;
+	}
+
+	if( virtio_console_send( xBufs, ulNum ) == 0 ) {
+		uxTxInflight = ( uxHead - uxTail ) & ( CONSOLE_TX_BUF_SIZE - 1 );
+	}
+}
+#endif /* CONSOLE_BACKEND */
+
+/* Push up to one FIFO worth of bytes into the UART.  Must be called with
+interrupts masked, i.e. from the ISR or from within a critical section. */
+static void prvTxFill( void )
+{
+size_t uxTail = uxTxTail;
 size_t i;
 
-	dev.addr = NS16550_ADDR;
+#if CONSOLE_BACKEND == CONSOLE_BACKEND_VIRTIO
+	if( xTxVirtio ) {
+		prvTxVirtio();
+		return;
+	}
+#endif
+
+	if( !xTxEmptyNS16550( &xConsoleDev ) ) {
+		return;
+	}
+
+	for( i = 0; ( i < NS16550_FIFO_DEPTH ) && ( uxTail != uxTxHead ); i++ ) {
+		vWriteNS16550( &xConsoleDev, cTxBuf[ uxTail ] );
+		uxTail = ( uxTail + 1 ) & ( CONSOLE_TX_BUF_SIZE - 1 );
+	}
+
+	uxTxTail = uxTail;
+}
+
+/* Copy len bytes into the ring.  If it runs full (e.g. because interrupts
+are not enabled yet) fall back to draining the UART synchronously. */
+static void prvTxEnqueue( const char *buf, size_t len )
+{
+size_t uxHead = uxTxHead;
+size_t uxFree, uxChunk;
+
+	while( len > 0 ) {
+		uxFree = ( uxTxTail - uxHead - 1 ) & ( CONSOLE_TX_BUF_SIZE - 1 );
+
+		if( uxFree == 0 ) {
+			uxTxHead = uxHead;
+			prvTxFill();
+			continue;
+		}
+
+		/* Don't copy past the end of the buffer, wrap in the next round */
+		uxChunk = CONSOLE_TX_BUF_SIZE - uxHead;
+		if( uxChunk > uxFree ) {
+			uxChunk = uxFree;
+		}
+		if( uxChunk > len ) {
+			uxChunk = len;
+		}
+
+		memcpy( &cTxBuf[ uxHead ], buf, uxChunk );
+		uxHead = ( uxHead + uxChunk ) & ( CONSOLE_TX_BUF_SIZE - 1 );
+		buf += uxChunk;
+		len -= uxChunk;
+	}
+
+	uxTxHead = uxHead;
+}
+
+/* Start a burst and let the THRE interrupt take care of the rest */
+static void prvTxKick( void )
+{
+#if CONSOLE_BACKEND == CONSOLE_BACKEND_VIRTIO
+	/* Every transfer is a VM exit, so wait until enough has piled up */
+	if( xTxVirtio ) {
+		if( ( ( ( uxTxHead - uxTxTail ) & ( CONSOLE_TX_BUF_SIZE - 1 ) ) - uxTxInflight ) >= CONSOLE_VIRTIO_BATCH ) {
+			prvTxVirtio();
+		}
+		return;
+	}
+#endif
+
+	prvTxFill();
+
+	if( uxTxTail != uxTxHead ) {
+		vEnableTxIrqNS16550( &xConsoleDev );
+	}
+}
+
+/* Move everything the UART received into the ring.  Must be called with
+interrupts masked. */
+static void prvRxDrain( void )
+{
+size_t uxHead = uxRxHead, uxNext;
+char c;
+
+	while( xRxReadyNS16550( &xConsoleDev ) ) {
+		c = ( char ) ucReadNS16550( &xConsoleDev );
+		uxNext = ( uxHead + 1 ) & ( CONSOLE_RX_BUF_SIZE - 1 );
+
+		if( uxNext != uxRxTail ) {
+			cRxBuf[ uxHead ] = c;
+			uxHead = uxNext;
+		}
+	}
 
+	uxRxHead = uxHead;
+}
+
+static void prvConsoleInterruptHandler( void *arg )
+{
+BaseType_t xWoken = pdFALSE;
+
+	( void ) arg;
+
+	prvRxDrain();
+
+	if( ( xRxWaiter != NULL ) && ( uxRxTail != uxRxHead ) ) {
+		vTaskNotifyGiveFromISR( xRxWaiter, &xWoken );
+		xRxWaiter = NULL;
+	}
+
+	prvTxFill();
+
+	if( uxTxTail == uxTxHead ) {
+		vDisableTxIrqNS16550( &xConsoleDev );
+	}
+
+	portYIELD_FROM_ISR( xWoken );
+}
+
+void vConsoleInit( void )
+{
+	vInitNS16550( &xConsoleDev );
+
+#if CONSOLE_BACKEND == CONSOLE_BACKEND_VIRTIO
+	xTxVirtio = ( virtio_console_init() == 0 );
+#endif
+
+	plic_register_handler( NS16550_IRQ, 1, prvConsoleInterruptHandler, NULL );
+	vEnableRxIrqNS16550( &xConsoleDev );
+}
+
+void vConsoleFlush( void )
+{
 	portENTER_CRITICAL();
 
-	for (i = 0; i < strlen(s); i++) {
-		vOutNS16550( &dev, s[i] );
+	while( uxTxTail != uxTxHead ) {
+		prvTxFill();
 	}
-	vOutNS16550( &dev, '\n' );
+	vDisableTxIrqNS16550( &xConsoleDev );
+
+	portEXIT_CRITICAL();
+}
+
+void vSendBytes( const char *buf, size_t len )
+{
+	portENTER_CRITICAL();
+
+	prvTxEnqueue( buf, len );
+	prvTxKick();
+
+	portEXIT_CRITICAL();
+}
+
+void vSendString( const char *s )
+{
+	portENTER_CRITICAL();
+
+	prvTxEnqueue( s, strlen( s ) );
+	prvTxEnqueue( "\n", 1 );
+	prvTxKick();
+
+	portEXIT_CRITICAL();
+}
+
+static void prvTxSink( void *ctx, const char *s, size_t len )
+{
+	( void ) ctx;
+
+	prvTxEnqueue( s, len );
+}
+
+/* Like vSendString(), but formats straight into the TX ring */
+void vSendFormat( const char *fmt, ... )
+{
+va_list ap;
+
+	va_start( ap, fmt );
+	portENTER_CRITICAL();
+
+	fmt_vformat( prvTxSink, NULL, fmt, ap );
+	prvTxEnqueue( "\n", 1 );
+	prvTxKick();
 
 	portEXIT_CRITICAL();
+	va_end( ap );
+}
+
+static int prvInterruptsEnabled( void )
+{
+uintptr_t sstatus;
+
+	__asm volatile( "csrr %0, sstatus" : "=r"( sstatus ) );
+
+	return ( sstatus & SSTATUS_SIE ) != 0;
+}
+
+/* Non-blocking, returns 1 if a byte was received */
+int xConsoleGetChar( char *c )
+{
+int xRet = 0, xPoll = !prvInterruptsEnabled();
+
+	portENTER_CRITICAL();
+
+	/* Interrupts might be off (e.g. bare-metal runs before the
+	scheduler), so look at the UART if nothing is buffered. Otherwise
+	the RX interrupt fills the ring and polling would only add VM exits. */
+	if( uxRxTail == uxRxHead ) {
+		if( xPoll ) {
+			prvRxDrain();
+		}
+
+		/* Whoever waits for input wants to see the output first */
+		if( uxTxTail != uxTxHead ) {
+			prvTxFill();
+		}
+	}
+
+	if( uxRxTail != uxRxHead ) {
+		*c = cRxBuf[ uxRxTail ];
+		uxRxTail = ( uxRxTail + 1 ) & ( CONSOLE_RX_BUF_SIZE - 1 );
+		xRet = 1;
+	}
+
+	portEXIT_CRITICAL();
+
+	return xRet;
+}
+
+/* Sleep in wfi until an external interrupt is pending, with sstatus.SIE
+cleared so no trap is taken, then handle it right here. Only the external
+interrupt is unmasked in sie for the wait. */
+static void prvWaitExternalInterrupt( void )
+{
+uintptr_t sstatus, sie;
+
+	__asm volatile( "csrrc %0, sstatus, %1" : "=r"( sstatus ) : "r"( SSTATUS_SIE ) );
+	__asm volatile( "csrrw %0, sie, %1" : "=r"( sie ) : "r"( SIE_SEIE ) );
+
+	__asm volatile( "wfi" );
+
+	__asm volatile( "csrw sie, %0" :: "r"( sie ) );
+
+	plic_dispatch();
+
+	__asm volatile( "csrs sstatus, %0" :: "r"( sstatus & SSTATUS_SIE ) );
+}
+
+/* Blocking, returns once a byte was received. With the scheduler running
+the calling task sleeps until the RX interrupt wakes it up, before that
+the hart waits for the RX interrupt in wfi. */
+void vConsoleWaitChar( char *c )
+{
+int xWait;
+
+	while( !xConsoleGetChar( c ) ) {
+		if( xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED ) {
+			/* The RX interrupt handler fills the ring */
+			prvWaitExternalInterrupt();
+			continue;
+		}
+
+		portENTER_CRITICAL();
+
+		/* A byte might have come in since xConsoleGetChar() */
+		xWait = ( uxRxTail == uxRxHead );
+		if( xWait ) {
+			xRxWaiter = xTaskGetCurrentTaskHandle();
+		}
+
+		portEXIT_CRITICAL();
+
+		if( xWait ) {
+			( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+		}
+	}
+}
+
+extern void freertos_risc_v_trap_handler( void );
+extern void freertos_vector_table( void );
+
+void vSetTrapMode( int vectored )
+{
+uintptr_t stvec;
+
+	if( vectored ) {
+		/* MODE = 1 in the lowest bits, the table is 128 byte aligned */
+		stvec = ( uintptr_t ) freertos_vector_table | 1;
+	} else {
+		stvec = ( uintptr_t ) freertos_risc_v_trap_handler;
+	}
+
+	__asm volatile(
+		"csrw stvec, %0\n"
+		:: "r"(stvec)
+		:
+	);
 }
 
 void handle_trap(void)
@@ -37,23 +37,153 @@
 
 #define PRIM_HART			0
 
+/* Harts the guest brings up, any further ones stay parked in wfi. Hart IDs
+are expected to be 0 .. NUM_HARTS - 1 and double as FreeRTOS core IDs. */
+#ifndef NUM_HARTS
+	#ifdef configNUMBER_OF_CORES
+		#define NUM_HARTS	configNUMBER_OF_CORES
+	#else
+		#define NUM_HARTS	1
+	#endif
+#endif
+
 #define PLIC_ADDR       CONS(0x0c000000, UL)
 #define PLIC_ADDR_PTR   ((uint8_t *) PLIC_ADDR)
 #define PLIC(offset)    *((volatile uint32_t *) (((uint64_t) PLIC_ADDR) + (offset)))
 
+/* PLIC register layout, ctx is the hart context interrupts are routed to */
+#define PLIC_PRIORITY(irq)		PLIC((irq) * 4)
+#define PLIC_ENABLE(ctx, irq)	PLIC(0x2000 + (ctx) * 0x80 + ((irq) / 32) * 4)
+#define PLIC_THRESHOLD(ctx)		PLIC(0x200000 + (ctx) * 0x1000)
+#define PLIC_CLAIM(ctx)			PLIC(0x200004 + (ctx) * 0x1000)
+
+#ifndef PLIC_NUM_SOURCES
+#define PLIC_NUM_SOURCES	64
+#endif
+
+/* Context of hart 0's supervisor mode */
+#ifndef PLIC_CONTEXT
+#define PLIC_CONTEXT		0
+#endif
+
+/* Contexts between the supervisor contexts of two harts (2 if the PLIC
+also exposes the M-mode ones) */
+#ifndef PLIC_CONTEXTS_PER_HART
+#define PLIC_CONTEXTS_PER_HART	1
+#endif
+
+#define PLIC_HART_CONTEXT(hart)	((hart) * PLIC_CONTEXTS_PER_HART + PLIC_CONTEXT)
+
 #define RTC_ADDR        CONS(0x10003000, UL)
 #define RTC_ADDR_PTR    ((uint8_t *) RTC_ADDR)
 #define RTC(offset)     *((volatile uint32_t *) (((uint64_t) RTC_ADDR) + (offset)))
 
+/* Use the vectored stvec mode with the per-cause fast paths in vector.S */
+#ifndef TRAP_VECTORED
+#define TRAP_VECTORED	0
+#endif
+
 #define NS16550_ADDR    CONS(0x10000000, UL)
+#define NS16550_IRQ     10
+
+/* virtio-mmio transports, laid out like on the QEMU virt machine */
+#define VIRTIO_MMIO_ADDR	CONS(0x10001000, UL)
+#define VIRTIO_MMIO_STRIDE	CONS(0x1000, UL)
+
+#ifndef VIRTIO_MMIO_SLOTS
+#define VIRTIO_MMIO_SLOTS	8
+#endif
+
+/* Where vSendString() output goes, selected with CONSOLE_BACKEND in the build.
+The NS16550 stays in use for input either way, and for output if no virtio
+console is found. */
+#define CONSOLE_BACKEND_NS16550	0
+#define CONSOLE_BACKEND_VIRTIO	1
+
+#ifndef CONSOLE_BACKEND
+#define CONSOLE_BACKEND		CONSOLE_BACKEND_NS16550
+#endif
+
+/* Pending output that triggers a virtio transfer. Anything less waits for
+more output, vConsoleFlush() or the next input poll. */
+#ifndef CONSOLE_VIRTIO_BATCH
+#define CONSOLE_VIRTIO_BATCH	( CONSOLE_TX_BUF_SIZE / 4 )
+#endif
+
+/* Size of the console TX ring buffer, must be a power of two */
+#ifndef CONSOLE_TX_BUF_SIZE
+#define CONSOLE_TX_BUF_SIZE	4096
+#endif
+
+/* Size of the console RX ring buffer, must be a power of two */
+#ifndef CONSOLE_RX_BUF_SIZE
+#define CONSOLE_RX_BUF_SIZE	256
+#endif
 
 #ifndef __ASSEMBLER__
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fmt.h"
+
+/* Hot paths go into the instruction scratchpad, hot data into the data
+scratchpad, so their latency does not depend on the cache state. Both are
+8 KiB, tools/spm_report.sh shows what is left. DSPM_BSS objects are zeroed
+at boot and must not have an initializer. */
+#define ISPM_TEXT	__attribute__(( section( ".ispm.text" ) ))
+#define DSPM_BSS	__attribute__(( section( ".dspm.bss" ) ))
+
+/* Large buffers that are set up before their first use go into .noinit,
+which start.S does not zero. Same rules as for DSPM_BSS otherwise. */
+#define NOINIT		__attribute__(( section( ".noinit" ) ))
+
 int xGetCoreID( void );
+void vSetTrapMode( int vectored );
+typedef void ( *plic_handler_t )( void *arg );
+
+void plic_init( void );
+void plic_init_hart( void );
+void plic_set_priority( uint32_t irq, uint32_t priority );
+void plic_set_threshold( uint32_t threshold );
+void plic_enable( uint32_t irq );
+void plic_disable( uint32_t irq );
+int plic_register_handler( uint32_t irq, uint32_t priority, plic_handler_t handler, void *arg );
+void plic_dispatch( void );
+uint32_t plic_get_spurious( void );
+
+void vConsoleInit( void );
+void vConsoleFlush( void );
+void vSendBytes( const char * buf, size_t len );
 void vSendString( const char * s );
+void vSendFormat( const char * fmt, ... ) FMT_PRINTF( 1, 2 );
+int xConsoleGetChar( char *c );
+void vConsoleWaitChar( char *c );
 void write32(void *addr, uint32_t val);
 uint32_t read32(void *addr);
 
+static inline uint64_t rdcycle(void)
+{
+	uint64_t cyc = 0;
+	__asm volatile(
+		"csrrs %0, cycle, x0\n"
+		: "=r"(cyc)
+		::
+	);
+	return cyc;
+}
+
+static inline uint64_t rdtime(void)
+{
+	uint64_t time = 0;
+	__asm volatile(
+		"csrrs %0, time, x0\n"
+		: "=r"(time)
+		::
+	);
+	return time;
+}
+
 #endif /* __ASSEMBLER__ */
 
 #endif /* RISCV_VIRT_H_ */
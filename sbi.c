@@ -0,0 +1,59 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "sbi.h"
+
+struct sbiret sbi_ecall(unsigned long ext, unsigned long fid, unsigned long arg0,
+						unsigned long arg1, unsigned long arg2, unsigned long arg3,
+						unsigned long arg4)
+{
+	struct sbiret ret;
+
+	register unsigned long a0 __asm__("a0") = arg0;
+	register unsigned long a1 __asm__("a1") = arg1;
+	register unsigned long a2 __asm__("a2") = arg2;
+	register unsigned long a3 __asm__("a3") = arg3;
+	register unsigned long a4 __asm__("a4") = arg4;
+	register unsigned long a6 __asm__("a6") = fid;
+	register unsigned long a7 __asm__("a7") = ext;
+
+	__asm volatile(
+		"ecall\n"
+		: "+r"(a0), "+r"(a1)
+		: "r"(a2), "r"(a3), "r"(a4), "r"(a6), "r"(a7)
+		: "memory"
+	);
+
+	ret.error = (long) a0;
+	ret.value = (long) a1;
+
+	return ret;
+}
+
+long sbi_probe_extension(unsigned long ext)
+{
+	struct sbiret ret = sbi_ecall(SBI_EXT_BASE, SBI_BASE_PROBE_EXT, ext, 0, 0, 0, 0);
+
+	if(ret.error != SBI_SUCCESS)
+		return 0;
+
+	return ret.value;
+}
+
+void sbi_set_timer(uint64_t stime_value)
+{
+	sbi_ecall(SBI_EXT_TIME, SBI_TIME_SET_TIMER, stime_value, 0, 0, 0, 0);
+}
+
+long sbi_send_ipi(unsigned long hart_mask, unsigned long hart_mask_base)
+{
+	return sbi_ecall(SBI_EXT_IPI, SBI_IPI_SEND_IPI, hart_mask, hart_mask_base, 0, 0, 0).error;
+}
+
+long sbi_hart_start(unsigned long hartid, unsigned long start_addr, unsigned long opaque)
+{
+	return sbi_ecall(SBI_EXT_HSM, SBI_HSM_HART_START, hartid, start_addr, opaque, 0, 0).error;
+}
@@ -0,0 +1,50 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef SBI_H_
+#define SBI_H_
+
+#include <stdint.h>
+
+// Supervisor Binary Interface calls into the hypervisor (or M-mode firmware)
+
+#define SBI_EXT_BASE			0x10
+#define SBI_EXT_TIME			0x54494D45
+#define SBI_EXT_IPI				0x735049
+#define SBI_EXT_HSM				0x48534D
+
+#define SBI_BASE_PROBE_EXT		3
+#define SBI_TIME_SET_TIMER		0
+#define SBI_IPI_SEND_IPI		0
+#define SBI_HSM_HART_START		0
+
+#define SBI_SUCCESS				0
+
+struct sbiret {
+	long error;
+	long value;
+};
+
+struct sbiret sbi_ecall(unsigned long ext, unsigned long fid, unsigned long arg0,
+						unsigned long arg1, unsigned long arg2, unsigned long arg3,
+						unsigned long arg4);
+
+// Returns non-zero if the extension is implemented
+long sbi_probe_extension(unsigned long ext);
+
+// Program the next supervisor timer interrupt (absolute time CSR value),
+// this also clears a pending one
+void sbi_set_timer(uint64_t stime_value);
+
+// Raise a supervisor software interrupt on every hart in hart_mask,
+// bit i stands for hart hart_mask_base + i
+long sbi_send_ipi(unsigned long hart_mask, unsigned long hart_mask_base);
+
+// Start a stopped hart in S-mode at start_addr with a0 = hartid, a1 = opaque
+// and translation off
+long sbi_hart_start(unsigned long hartid, unsigned long start_addr, unsigned long opaque);
+
+#endif /* SBI_H_ */
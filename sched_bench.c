@@ -0,0 +1,202 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include "bench_stats.h"
+#include "obj_pool.h"
+#include "riscv-virt.h"
+#include "sched_bench.h"
+#include "sched_trace.h"
+#include "tick.h"
+
+#if SCHED_BENCH
+
+// The probe hands its results to the logger, so no printing (and no
+// UART interrupts) disturbs the measurements
+struct sched_report {
+	const char *tag;
+	const struct bench_stats *st;	// NULL: print the tick statistics
+};
+
+static TaskHandle_t probe_handle = NULL;
+static TaskHandle_t adversary_handle = NULL;
+static QueueHandle_t report_queue = NULL;
+
+// Written by whichever task of the ping-pong runs
+static volatile uint64_t switch_stamp = 0;
+
+static struct bench_stats yield_stats;
+static struct bench_stats switch_stats;
+static struct bench_stats gap_stats;
+
+static struct tick_stats tick_before, tick_after;
+
+// Probe and adversary switch back and forth all the time
+static DSPM_BSS StaticTask_t probe_tcb;
+static DSPM_BSS StaticTask_t adversary_tcb;
+static StackType_t probe_stack[configMINIMAL_STACK_SIZE * 2U];
+static StackType_t adversary_stack[configMINIMAL_STACK_SIZE * 2U];
+
+/*-----------------------------------------------------------*/
+
+// Yield without another ready task of the same priority: trap (scause 1),
+// vTaskSwitchContext() picks the same task again, return
+static void measure_yield(void)
+{
+	uint64_t start = 0;
+
+	bench_stats_reset(&yield_stats);
+
+	for(int i = 0; i < SCHED_BENCH_ROUNDS; i++){
+		start = rdcycle();
+		taskYIELD();
+		bench_stats_add(&yield_stats, rdcycle() - start);
+	}
+}
+
+// Notify the adversary and wait for it to notify us back. Both sides
+// record the time from giving the notification to running in the other
+// task, which includes one full context switch.
+static void measure_switch(void)
+{
+	bench_stats_reset(&switch_stats);
+
+	for(int i = 0; i < SCHED_BENCH_ROUNDS; i++){
+		switch_stamp = rdcycle();
+		xTaskNotifyGive(adversary_handle);
+
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		bench_stats_add(&switch_stats, rdcycle() - switch_stamp);
+	}
+
+	// Release the adversary from the ping-pong
+	switch_stamp = 0;
+	xTaskNotifyGive(adversary_handle);
+}
+
+// Spin on rdcycle, every gap is an interrupt (mostly the tick) or the
+// hypervisor running somebody else
+static void measure_ticks(void)
+{
+	uint64_t first = 0, second = 0;
+	TickType_t end = 0;
+
+	bench_stats_reset(&gap_stats);
+	tick_get_stats(&tick_before);
+
+	end = xTaskGetTickCount() + SCHED_BENCH_SPIN_TICKS;
+
+	first = rdcycle();
+	while(xTaskGetTickCount() < end){
+		second = rdcycle();
+
+		if(second - first > SCHED_BENCH_GAP_THRESH)
+			bench_stats_add(&gap_stats, second - first);
+
+		first = second;
+	}
+
+	tick_get_stats(&tick_after);
+}
+
+static void report(const char *tag, const struct bench_stats *st)
+{
+	struct sched_report r = { .tag = tag, .st = st };
+
+	xQueueSend(report_queue, &r, portMAX_DELAY);
+}
+
+static void probe_task(void *pvParameters)
+{
+	(void) pvParameters;
+
+	vSendString("[sched_bench] Starting");
+	vConsoleFlush();
+
+	measure_yield();
+	measure_switch();
+	measure_ticks();
+
+	report("sched_bench yield", &yield_stats);
+	report("sched_bench notify + switch", &switch_stats);
+	report("sched_bench interrupt gaps", &gap_stats);
+	report(NULL, NULL);
+
+	vTaskDelete(NULL);
+}
+
+static void adversary_task(void *pvParameters)
+{
+	(void) pvParameters;
+
+	while(1){
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		// The probe is done with the ping-pong
+		if(!switch_stamp)
+			break;
+
+		bench_stats_add(&switch_stats, rdcycle() - switch_stamp);
+
+		switch_stamp = rdcycle();
+		xTaskNotifyGive(probe_handle);
+	}
+
+	vTaskDelete(NULL);
+}
+
+static void logger_task(void *pvParameters)
+{
+	struct sched_report r;
+
+	(void) pvParameters;
+
+	while(1){
+		xQueueReceive(report_queue, &r, portMAX_DELAY);
+
+		if(r.st){
+			bench_stats_report(r.st, r.tag);
+			continue;
+		}
+
+		uint64_t irqs = tick_after.irqs - tick_before.irqs;
+		uint64_t cycles = tick_after.isr_cycles - tick_before.isr_cycles;
+
+		vSendFormat("[sched_bench] tick isr: %lu irqs, mean %lu, max %lu cycles, %lu missed ticks",
+					irqs, irqs ? cycles / irqs : 0, tick_after.isr_max_cycles,
+					tick_after.missed - tick_before.missed);
+
+#if SCHED_TRACE
+		sched_trace_dump();
+#endif
+#if RUNTIME_STATS
+		sched_trace_runtime_report();
+#endif
+
+		vSendString("[sched_bench] Done!");
+		vConsoleFlush();
+	}
+}
+
+/*-----------------------------------------------------------*/
+
+void sched_bench_create_tasks(void)
+{
+	report_queue = obj_pool_queue_create(4, sizeof(struct sched_report));
+
+	probe_handle = xTaskCreateStatic(probe_task, "SchedProbe", configMINIMAL_STACK_SIZE * 2U, NULL,
+									 SCHED_PROBE_PRIO, probe_stack, &probe_tcb);
+	adversary_handle = xTaskCreateStatic(adversary_task, "SchedAdv", configMINIMAL_STACK_SIZE * 2U, NULL,
+										 SCHED_ADVERSARY_PRIO, adversary_stack, &adversary_tcb);
+	obj_pool_task_create(logger_task, "SchedLog", NULL, SCHED_LOGGER_PRIO);
+
+	sched_trace_start();
+}
+
+#endif /* SCHED_BENCH */
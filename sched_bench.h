@@ -0,0 +1,53 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef SCHED_BENCH_H_
+#define SCHED_BENCH_H_
+
+#include <FreeRTOS.h>
+
+// Measure what the RTOS itself costs: yield, task-to-task switch and the
+// tick interrupt. Runs a probe, an adversary and a logger task under the
+// scheduler instead of the bare-metal probe run.
+#ifndef SCHED_BENCH
+#define SCHED_BENCH 0
+#endif
+
+#ifndef SCHED_BENCH_ROUNDS
+#define SCHED_BENCH_ROUNDS 10000
+#endif
+
+// Ticks the probe task spins for to catch the tick interrupts
+#ifndef SCHED_BENCH_SPIN_TICKS
+#define SCHED_BENCH_SPIN_TICKS 1000
+#endif
+
+// Two back-to-back rdcycle reads further apart than this were interrupted
+#ifndef SCHED_BENCH_GAP_THRESH
+#define SCHED_BENCH_GAP_THRESH 200
+#endif
+
+// Task priorities, all below the timer task
+#ifndef SCHED_PROBE_PRIO
+#define SCHED_PROBE_PRIO		( tskIDLE_PRIORITY + 2 )
+#endif
+
+#ifndef SCHED_ADVERSARY_PRIO
+#define SCHED_ADVERSARY_PRIO	( tskIDLE_PRIORITY + 3 )
+#endif
+
+#ifndef SCHED_LOGGER_PRIO
+#define SCHED_LOGGER_PRIO		( tskIDLE_PRIORITY + 1 )
+#endif
+
+#if SCHED_BENCH
+
+// Create the tasks, the caller starts the scheduler
+void sched_bench_create_tasks(void);
+
+#endif /* SCHED_BENCH */
+
+#endif /* SCHED_BENCH_H_ */
@@ -0,0 +1,119 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "bench_record.h"
+#include "riscv-virt.h"
+#include "sched_trace.h"
+
+#if SCHED_TRACE
+// Cleared by sched_trace_start(), not at boot
+NOINIT uint64_t sched_trace_ring[SCHED_TRACE_EVENTS];
+
+// Touched on every event, the ring itself is too large for the DSPM
+DSPM_BSS uint64_t sched_trace_head;
+DSPM_BSS volatile uint32_t sched_trace_on;
+#endif
+
+#if RUNTIME_STATS
+uint64_t sched_trace_runtime_base = 0;
+#endif
+
+#if configUSE_TRACE_FACILITY
+static TaskStatus_t tasks[SCHED_TRACE_MAX_TASKS];
+#endif
+
+/*-----------------------------------------------------------*/
+
+void sched_trace_start(void)
+{
+#if SCHED_TRACE
+	sched_trace_on = 0;
+	__asm volatile("fence rw, rw" ::: "memory");
+
+	// Empty slots are all zero, the decoder never sees them
+	for(uint32_t i = 0; i < SCHED_TRACE_EVENTS; i++)
+		sched_trace_ring[i] = 0;
+	sched_trace_head = 0;
+
+	__asm volatile("fence rw, rw" ::: "memory");
+	sched_trace_on = 1;
+#endif
+}
+
+void sched_trace_stop(void)
+{
+#if SCHED_TRACE
+	sched_trace_on = 0;
+	__asm volatile("fence rw, rw" ::: "memory");
+#endif
+}
+
+void sched_trace_dump(void)
+{
+#if SCHED_TRACE
+	struct bench_record rec;
+	uint64_t head = 0, num = 0, ev = 0;
+	UBaseType_t num_tasks = 0;
+
+	sched_trace_stop();
+
+	head = sched_trace_head;
+	num = (head < SCHED_TRACE_EVENTS) ? head : SCHED_TRACE_EVENTS;
+
+	bench_record_begin(&rec);
+
+	// Names first, so the decoder can label the events right away
+	num_tasks = uxTaskGetSystemState(tasks, SCHED_TRACE_MAX_TASKS, NULL);
+	for(UBaseType_t i = 0; i < num_tasks; i++)
+		bench_record_task(&rec, tasks[i].xTaskNumber, tasks[i].pcTaskName);
+
+	for(uint64_t i = head - num; i < head; i++){
+		ev = sched_trace_ring[i & (SCHED_TRACE_EVENTS - 1)];
+		if(!ev)
+			continue;
+
+		bench_record_trace(&rec, ev >> SCHED_TRACE_TS_SHIFT, (uint8_t) (ev >> 8), (uint8_t) ev);
+	}
+
+	bench_record_flush(&rec);
+
+	vSendFormat("[sched_trace] %lu events, %lu overwritten", num, head - num);
+#else
+	vSendString("[sched_trace] built without SCHED_TRACE");
+#endif
+}
+
+/*-----------------------------------------------------------*/
+
+#if RUNTIME_STATS
+void sched_trace_runtime_init(void)
+{
+	sched_trace_runtime_base = rdcycle();
+}
+#endif
+
+void sched_trace_runtime_report(void)
+{
+#if RUNTIME_STATS
+	configRUN_TIME_COUNTER_TYPE total = 0;
+	UBaseType_t num_tasks = uxTaskGetSystemState(tasks, SCHED_TRACE_MAX_TASKS, &total);
+	uint64_t share_x100 = 0;
+
+	vSendFormat("[runtime] %lu cycles since the scheduler started", total);
+
+	for(UBaseType_t i = 0; i < num_tasks; i++){
+		share_x100 = total ? (tasks[i].ulRunTimeCounter * 10000) / total : 0;
+
+		vSendFormat("[runtime] %-16s %lu cycles, %lu.%02lu%%", tasks[i].pcTaskName,
+					tasks[i].ulRunTimeCounter, share_x100 / 100, share_x100 % 100);
+	}
+#else
+	vSendString("[runtime] built without RUNTIME_STATS");
+#endif
+}
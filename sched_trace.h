@@ -0,0 +1,101 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef SCHED_TRACE_H_
+#define SCHED_TRACE_H_
+
+#include <stdint.h>
+
+#include "riscv-virt.h"
+
+// Scheduler trace ring and run-time stats
+//
+// With SCHED_TRACE=1 the kernel trace hooks, the yield path and the tick
+// interrupt log timestamped events into a ring of SCHED_TRACE_EVENTS
+// 64-bit words: cycle count << 16 | type << 8 | argument. Logging an event
+// costs a cycle CSR read, an amoadd to reserve the slot and a store, no
+// lock is taken. Once the ring is full the oldest events are overwritten.
+// sched_trace_dump() sends the ring as BENCH_RECORD_TRACE frames,
+// tools/record_decode -t turns them into a timeline.
+//
+// With RUNTIME_STATS=1 the kernel accounts run time per task on the cycle
+// counter, sched_trace_runtime_report() prints it.
+
+#ifndef SCHED_TRACE
+#define SCHED_TRACE				0
+#endif
+
+#ifndef RUNTIME_STATS
+#define RUNTIME_STATS			0
+#endif
+
+// Must be a power of two
+#ifndef SCHED_TRACE_EVENTS
+#define SCHED_TRACE_EVENTS		1024
+#endif
+
+// Tasks the reports can handle
+#ifndef SCHED_TRACE_MAX_TASKS
+#define SCHED_TRACE_MAX_TASKS	16
+#endif
+
+// Event types, the argument is a task number or an interrupt source
+#define SCHED_TRACE_SWITCH_IN	1
+#define SCHED_TRACE_SWITCH_OUT	2
+#define SCHED_TRACE_ISR_ENTER	3
+#define SCHED_TRACE_ISR_EXIT	4
+#define SCHED_TRACE_YIELD		5
+
+#define SCHED_TRACE_TS_SHIFT	16
+
+#if SCHED_TRACE
+
+extern uint64_t sched_trace_ring[SCHED_TRACE_EVENTS];
+extern uint64_t sched_trace_head;
+extern volatile uint32_t sched_trace_on;
+
+static inline void sched_trace_event(uint8_t type, uint8_t arg)
+{
+	uint64_t idx = 0;
+
+	if(!sched_trace_on)
+		return;
+
+	idx = __atomic_fetch_add(&sched_trace_head, 1, __ATOMIC_RELAXED);
+	sched_trace_ring[idx & (SCHED_TRACE_EVENTS - 1)] =
+		(rdcycle() << SCHED_TRACE_TS_SHIFT) | ((uint64_t) type << 8) | arg;
+}
+
+#else
+
+static inline void sched_trace_event(uint8_t type, uint8_t arg)
+{
+	(void) type;
+	(void) arg;
+}
+
+#endif /* SCHED_TRACE */
+
+// Clear the ring and start logging
+void sched_trace_start(void);
+
+void sched_trace_stop(void);
+
+// Stop logging and send task names and events (oldest first) to the UART
+void sched_trace_dump(void);
+
+// Run time and share of every task since the scheduler started
+void sched_trace_runtime_report(void);
+
+#if RUNTIME_STATS
+// Run-time counter is the cycle counter minus its value at scheduler start
+extern uint64_t sched_trace_runtime_base;
+
+// portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+void sched_trace_runtime_init(void);
+#endif
+
+#endif
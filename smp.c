@@ -0,0 +1,167 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "riscv-virt.h"
+#include "sbi.h"
+#include "smp.h"
+
+#define SIE_SSIE		(1 << 1)
+#define SIP_SSIP		(1 << 1)
+
+enum job_state {
+	JOB_IDLE = 0,
+	JOB_PENDING,
+	JOB_RUNNING,
+};
+
+struct hart_job {
+	smp_job_t job;
+	void *arg;
+	volatile uint64_t state;
+};
+
+static volatile uint64_t online_mask = 0;
+
+static struct hart_job jobs[NUM_HARTS];
+
+// Entry point for hart_start, see start.S
+extern char _secondary_entry[];
+
+/*-----------------------------------------------------------*/
+
+uint64_t smp_boot(void)
+{
+	uint64_t start = 0, want = 0, num = 0;
+
+	online_mask = 1UL << xGetCoreID();
+
+	if(NUM_HARTS == 1)
+		return 1;
+
+	if(!sbi_probe_extension(SBI_EXT_HSM)){
+		vSendString("[smp] No SBI HSM extension, secondaries stay parked");
+		return 1;
+	}
+
+	want = (NUM_HARTS >= 64) ? ~0UL : (1UL << NUM_HARTS) - 1;
+
+	// Everything the secondaries read (.data, .bss, the relocated image)
+	// has to be visible before they start
+	__asm volatile("fence rw, rw\n" ::: "memory");
+
+	for(uint64_t hart = 0; hart < NUM_HARTS; hart++){
+		if(hart == (uint64_t) xGetCoreID())
+			continue;
+
+		if(sbi_hart_start(hart, (unsigned long) _secondary_entry, 0) != SBI_SUCCESS)
+			vSendFormat("[smp] hart %lu did not start", hart);
+	}
+
+	// We might have been given fewer vCPUs than NUM_HARTS
+	start = rdcycle();
+	while(online_mask != want && rdcycle() - start < SMP_BOOT_TIMEOUT){}
+
+	for(uint64_t mask = online_mask; mask; mask &= mask - 1)
+		num++;
+
+	vSendFormat("[smp] %lu of %u harts online", num, NUM_HARTS);
+
+	return num;
+}
+
+uint64_t smp_online_mask(void)
+{
+	return online_mask;
+}
+
+int smp_run_on(uint64_t hart, smp_job_t job, void *arg)
+{
+	if(hart >= NUM_HARTS || !(online_mask & (1UL << hart)) || jobs[hart].state != JOB_IDLE)
+		return -1;
+
+	jobs[hart].job = job;
+	jobs[hart].arg = arg;
+
+	__asm volatile("fence rw, rw\n" ::: "memory");
+	jobs[hart].state = JOB_PENDING;
+
+	sbi_send_ipi(1UL << hart, 0);
+
+	return 0;
+}
+
+void smp_wait(uint64_t hart)
+{
+	while(jobs[hart].state != JOB_IDLE){}
+
+	__asm volatile("fence rw, rw\n" ::: "memory");
+}
+
+void vPortYieldCore(int core)
+{
+	if(core == xGetCoreID()){
+		__asm volatile(
+			"csrrs x0, sip, %0\n"
+			:: "r"(SIP_SSIP)
+			:
+		);
+	} else {
+		sbi_send_ipi(1UL << core, 0);
+	}
+}
+
+/*-----------------------------------------------------------*/
+
+// Secondaries never enable interrupts, anything ending up here is fatal
+static __attribute__((aligned(4))) void secondary_trap(void)
+{
+	while(1){}
+}
+
+void secondary_main(uint64_t hartid)
+{
+	struct hart_job *j = &jobs[hartid];
+
+	__asm volatile(
+		"csrw stvec, %0\n"
+		:: "r"(secondary_trap)
+		:
+	);
+
+	// The IPI only has to end wfi, sstatus.SIE stays off
+	__asm volatile(
+		"csrrs x0, sie, %0\n"
+		:: "r"(SIE_SSIE)
+		:
+	);
+
+	plic_init_hart();
+
+	__atomic_fetch_or(&online_mask, 1UL << hartid, __ATOMIC_SEQ_CST);
+
+	while(1){
+		// Clear the IPI before looking at the state, so one arriving
+		// in between keeps wfi from sleeping
+		__asm volatile(
+			"csrrc x0, sip, %0\n"
+			:: "r"(SIP_SSIP)
+			:
+		);
+
+		if(j->state != JOB_PENDING){
+			__asm volatile("wfi\n");
+			continue;
+		}
+
+		__asm volatile("fence rw, rw\n" ::: "memory");
+		j->state = JOB_RUNNING;
+
+		j->job(j->arg);
+
+		__asm volatile("fence rw, rw\n" ::: "memory");
+		j->state = JOB_IDLE;
+	}
+}
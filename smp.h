@@ -0,0 +1,53 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef SMP_H_
+#define SMP_H_
+
+#include <stdint.h>
+
+#include "riscv-virt.h"
+
+// Secondary harts
+//
+// smp_boot() starts the secondaries through SBI HSM hart_start once the
+// image is set up. They enter _secondary_entry in start.S, get their own
+// stack (see .hart_stacks in vm-guest.ld) and tp set to their hart ID and
+// continue in secondary_main(), where they sleep in wfi until the primary
+// hart hands them a job and sends an IPI. Without HSM, or when a hart
+// enters _start at reset anyway, the secondaries stay parked.
+//
+// The secondaries run their jobs bare-metal: the RISC-V port of the
+// kernel has no per-core context switching, so FreeRTOS itself stays on
+// the primary hart. portGET_CORE_ID() and portYIELD_CORE() are provided
+// for a port that has it (see FreeRTOSConfig.h).
+
+// Cycles smp_boot() waits for the secondaries to come up
+#ifndef SMP_BOOT_TIMEOUT
+#define SMP_BOOT_TIMEOUT	100000000UL
+#endif
+
+typedef void (*smp_job_t)(void *arg);
+
+// Start the secondaries, returns the number of harts online (incl. this one)
+uint64_t smp_boot(void);
+
+// Bit i is set if hart i is online
+uint64_t smp_online_mask(void);
+
+// Run job(arg) on a secondary hart, returns -1 if it is offline or busy
+int smp_run_on(uint64_t hart, smp_job_t job, void *arg);
+
+// Wait for the job on hart to finish
+void smp_wait(uint64_t hart);
+
+// Send a software interrupt (a yield for the kernel) to another core
+void vPortYieldCore(int core);
+
+// Entered from start.S
+void secondary_main(uint64_t hartid);
+
+#endif /* SMP_H_ */
@@ -0,0 +1,169 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "riscv-virt.h"
+#include "sv39.h"
+
+#if SV39_PAGE_SIZE != SV39_PAGE_4K && SV39_PAGE_SIZE != SV39_PAGE_2M && SV39_PAGE_SIZE != SV39_PAGE_1G
+#error SV39_PAGE_SIZE must be SV39_PAGE_4K, SV39_PAGE_2M or SV39_PAGE_1G
+#endif
+
+#define PTE_V			(1UL << 0)
+#define PTE_R			(1UL << 1)
+#define PTE_W			(1UL << 2)
+#define PTE_X			(1UL << 3)
+#define PTE_G			(1UL << 5)
+#define PTE_A			(1UL << 6)
+#define PTE_D			(1UL << 7)
+
+// A and D are set up front, the hart may not update them in hardware
+#define PTE_LEAF(pa, flags)	((((uint64_t) (pa) >> 12) << 10) | PTE_V | PTE_R | PTE_W | PTE_X | PTE_A | PTE_D | (flags))
+#define PTE_TABLE(table)	((((uint64_t) (table) >> 12) << 10) | PTE_V)
+#define PTE_ADDR(pte)		((uint64_t *) (((pte) >> 10) << 12))
+
+#define PTES			512
+#define VPN(va, level)	(((va) >> (12 + 9 * (level))) & (PTES - 1))
+
+#define SATP_MODE_SV39		(8UL << 60)
+#define SATP_ASID_SHIFT		44
+#define SATP_ASID_MASK		0xFFFFUL
+
+// GiBs of the identity map: PLIC and UART in the first, RAM and SPMs in the second
+#define IDENTITY_GIBS	4
+
+#if SV39
+
+// Only the tables are identity mapped, so their virtual address is their
+// physical address
+static uint64_t root[PTES] __attribute__((aligned(4096)));
+static uint64_t l1[PTES] __attribute__((aligned(4096)));
+static uint64_t l0[SV39_L0_TABLES][PTES] __attribute__((aligned(4096)));
+static uint32_t l0_used = 0;
+
+static uint64_t asid = 0;
+static uint64_t alias_page_size = 0;
+static int enabled = 0;
+
+static inline void write_satp(uint64_t satp)
+{
+	// Order the table stores before the first walk and drop anything
+	// cached from before
+	__asm volatile(
+		"sfence.vma zero, zero\n"
+		"csrw satp, %0\n"
+		"sfence.vma zero, zero\n"
+		:: "r"(satp)
+		: "memory"
+	);
+}
+
+static inline uint64_t read_satp(void)
+{
+	uint64_t satp = 0;
+	__asm volatile(
+		"csrr %0, satp\n"
+		: "=r"(satp)
+	);
+	return satp;
+}
+
+#endif /* SV39 */
+
+/*-----------------------------------------------------------*/
+
+int sv39_setup(void)
+{
+#if SV39
+	uint64_t satp = 0, asid_mask = 0;
+
+	for(uint64_t i = 0; i < IDENTITY_GIBS; i++)
+		root[i] = PTE_LEAF(i << 30, PTE_G);
+
+	// The ASID field is WARL, writing all ones leaves the implemented bits
+	write_satp(SATP_MODE_SV39 | (SATP_ASID_MASK << SATP_ASID_SHIFT) | ((uint64_t) root >> 12));
+	satp = read_satp();
+
+	// A mode the hart does not support ignores the whole write
+	if((satp & SATP_MODE_SV39) != SATP_MODE_SV39){
+		vSendString("[sv39] Sv39 is not supported, running untranslated");
+		return -1;
+	}
+
+	asid_mask = (satp >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+	asid = SV39_ASID & asid_mask;
+	write_satp(SATP_MODE_SV39 | (asid << SATP_ASID_SHIFT) | ((uint64_t) root >> 12));
+	enabled = 1;
+
+	vSendFormat("[sv39] translation on, asid %lu (%d asid bits)", asid,
+				__builtin_popcountl(asid_mask));
+#endif
+
+	return 0;
+}
+
+void *sv39_map_alias(void *buf, size_t len)
+{
+#if SV39
+	uint64_t start = (uint64_t) buf & ~(SV39_PAGE_SIZE - 1);
+	uint64_t end = ((uint64_t) buf + len + SV39_PAGE_SIZE - 1) & ~(SV39_PAGE_SIZE - 1);
+	uint64_t base = SV39_ALIAS_BASE + (start & (SV39_PAGE_1G - 1));
+	uint64_t va = base;
+
+	if(!enabled)
+		return buf;
+
+	// The alias window is a single root entry
+	if((start >> 30) != ((end - 1) >> 30)){
+		vSendString("[sv39] buffer crosses a 1 GiB boundary, not aliased");
+		return buf;
+	}
+
+	if(SV39_PAGE_SIZE == SV39_PAGE_1G){
+		root[VPN(va, 2)] = PTE_LEAF(start, 0);
+	} else {
+		root[VPN(va, 2)] = PTE_TABLE(l1);
+
+		for(uint64_t pa = start; pa < end; pa += SV39_PAGE_SIZE, va += SV39_PAGE_SIZE){
+			if(SV39_PAGE_SIZE == SV39_PAGE_2M){
+				l1[VPN(va, 1)] = PTE_LEAF(pa, 0);
+				continue;
+			}
+
+			if(!l1[VPN(va, 1)]){
+				if(l0_used == SV39_L0_TABLES){
+					vSendString("[sv39] out of page tables, not aliased");
+					return buf;
+				}
+				l1[VPN(va, 1)] = PTE_TABLE(l0[l0_used++]);
+			}
+
+			PTE_ADDR(l1[VPN(va, 1)])[VPN(va, 0)] = PTE_LEAF(pa, 0);
+		}
+	}
+
+	// Invalid entries may have been cached as well
+	__asm volatile("sfence.vma zero, zero" ::: "memory");
+
+	alias_page_size = SV39_PAGE_SIZE;
+
+	vSendFormat("[sv39] %p mapped at %p with %lu KiB pages", buf,
+				(void *) (base + ((uint64_t) buf - start)), alias_page_size >> 10);
+
+	return (void *) (base + ((uint64_t) buf - start));
+#else
+	(void) len;
+	return buf;
+#endif
+}
+
+uint64_t sv39_alias_page_size(void)
+{
+#if SV39
+	return alias_page_size;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,66 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef SV39_H_
+#define SV39_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Guest-managed Sv39 page tables
+//
+// Without them the guest runs untranslated and a probe only exercises the
+// G-stage of the hypervisor. With SV39=1 sv39_setup() identity maps the
+// low 4 GiB (devices, RAM and the scratchpads) with global 1 GiB pages and
+// turns on translation. sv39_map_alias() then maps a buffer a second time
+// into an alias window with SV39_PAGE_SIZE pages, non-global and tagged
+// with SV39_ASID. Every access through the alias takes a two-stage walk
+// on a TLB miss.
+//
+// The alias keeps the offset of the buffer within its 1 GiB region, so
+// superpages simply cover the aligned region around the buffer (the whole
+// RAM is smaller than 2 MiB).
+//
+// Only the primary hart uses the page tables, the others keep running
+// untranslated.
+
+#ifndef SV39
+#define SV39				0
+#endif
+
+// Page size of the alias mapping: 4 KiB, 2 MiB or 1 GiB
+#ifndef SV39_PAGE_SIZE
+#define SV39_PAGE_SIZE		SV39_PAGE_4K
+#endif
+
+// Address space of the alias, truncated to the ASID bits the hart has
+#ifndef SV39_ASID
+#define SV39_ASID			1
+#endif
+
+#define SV39_PAGE_4K		(1UL << 12)
+#define SV39_PAGE_2M		(1UL << 21)
+#define SV39_PAGE_1G		(1UL << 30)
+
+// Base of the alias window, 1 GiB aligned above the identity map
+#define SV39_ALIAS_BASE		(8UL << 30)
+
+// Last level tables for 4 KiB alias pages, each covers 2 MiB
+#ifndef SV39_L0_TABLES
+#define SV39_L0_TABLES		2
+#endif
+
+// Identity map and enable translation, returns 0 on success
+int sv39_setup(void);
+
+// Map [buf, buf + len) into the alias window. Returns the alias of buf,
+// or buf itself if translation is off or the buffer does not fit.
+void *sv39_map_alias(void *buf, size_t len);
+
+// Page size used for the alias (0 while translation is off)
+uint64_t sv39_alias_page_size(void);
+
+#endif
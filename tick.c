@@ -0,0 +1,265 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+//
+// FreeRTOS tick on top of the Goldfish RTC alarm or the supervisor timer
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "clocksource.h"
+#include "goldfish_rtc.h"
+#include "riscv-virt.h"
+#include "sbi.h"
+#include "sched_trace.h"
+#include "tick.h"
+
+#if TIMER_BACKEND != TIMER_BACKEND_GOLDFISH && defined(CLOCKSOURCE_USE_CYCLE)
+#error "The SBI and Sstc timer backends need the time CSR based clocksource"
+#endif
+
+#define SIE_STIE		(1 << 5)
+
+// Interrupt source in the trace, 0 stands for the supervisor timer
+#if TIMER_BACKEND == TIMER_BACKEND_GOLDFISH
+#define TICK_TRACE_SRC	TICK_RTC_IRQ
+#else
+#define TICK_TRACE_SRC	0
+#endif
+
+extern size_t uxTimerIncrementsForOneTick;
+
+// One tick in timer units
+static uint64_t tick_period = 0;
+
+// Timer value at which the next tick is due
+static uint64_t next_tick_time = 0;
+
+static struct tick_stats stats;
+
+/*-----------------------------------------------------------*/
+
+// Timer backends: deadlines are Goldfish RTC ns or time CSR values
+
+#if TIMER_BACKEND == TIMER_BACKEND_GOLDFISH
+
+static inline uint64_t timer_now(void)
+{
+	return clocksource_now_ns();
+}
+
+// Writing the alarm replaces an armed one, so no clear first: on the tick
+// path timer_ack() already did that and every access is a VM exit
+static inline void timer_program(uint64_t deadline)
+{
+	goldfish_rtc_set_alarm(RTC_ADDR_PTR, deadline);
+}
+
+static inline void timer_ack(void)
+{
+	goldfish_rtc_clear_alarm(RTC_ADDR_PTR);
+	goldfish_rtc_clear_interrupt(RTC_ADDR_PTR);
+}
+
+static void timer_irq(void *arg)
+{
+	(void) arg;
+
+	tick_handle_interrupt();
+}
+
+static void timer_enable(void)
+{
+	// RTC is interrupt 11, the tick gets the highest priority
+	plic_register_handler(TICK_RTC_IRQ, TICK_RTC_IRQ_PRIO, timer_irq, NULL);
+
+	// Enable RTC interrupt
+	goldfish_rtc_enable_interrupt(RTC_ADDR_PTR);
+}
+
+#else
+
+static inline uint64_t timer_now(void)
+{
+	return rdtime();
+}
+
+static inline void timer_program(uint64_t deadline)
+{
+#if TIMER_BACKEND == TIMER_BACKEND_SSTC
+	// stimecmp
+	__asm volatile(
+		"csrw 0x14D, %0\n"
+		:: "r"(deadline)
+		:
+	);
+#else
+	sbi_set_timer(deadline);
+#endif
+}
+
+// Programming the next deadline clears the pending timer interrupt
+static inline void timer_ack(void)
+{
+}
+
+static void timer_enable(void)
+{
+	__asm volatile(
+		"csrrs x0, sie, %0\n"
+		:: "r"(SIE_STIE)
+		:
+	);
+}
+
+#endif /* TIMER_BACKEND */
+
+/*-----------------------------------------------------------*/
+
+void vPortSetupTimerInterrupt( void )
+{
+	vSendString("Setting up timer interrupt...");
+
+#if TIMER_BACKEND == TIMER_BACKEND_GOLDFISH
+	tick_period = uxTimerIncrementsForOneTick;
+
+	// Clear the RTC interrupt and alarm
+	goldfish_rtc_clear_alarm(RTC_ADDR_PTR);
+	goldfish_rtc_clear_interrupt(RTC_ADDR_PTR);
+#else
+	// The port hands us the tick length in ns, scale it to the timebase
+	tick_period = clocksource_ns_to_cnt(uxTimerIncrementsForOneTick);
+#endif
+
+	next_tick_time = timer_now() + tick_period;
+	timer_program(next_tick_time);
+
+	timer_enable();
+
+	vSendString("Done");
+}
+
+void tick_handle_interrupt(void)
+{
+	uint64_t cur_time = 0, late = 0, ticks = 1, start = rdcycle(), cycles = 0;
+	BaseType_t switch_needed = pdFALSE;
+
+	sched_trace_event(SCHED_TRACE_ISR_ENTER, TICK_TRACE_SRC);
+
+	timer_ack();
+
+	// Find out how late we are, e.g. because the VM was descheduled
+	cur_time = timer_now();
+
+	if(cur_time > next_tick_time){
+		late = cur_time - next_tick_time;
+		ticks += late / tick_period;
+	}
+
+	stats.ticks += ticks;
+	stats.missed += ticks - 1;
+	if(late > stats.max_lateness)
+		stats.max_lateness = late;
+
+	// Take care of the scheduling stuff, replaying every tick that
+	// we missed so the tick count keeps up with wall clock time
+	for(uint64_t i = 0; i < ticks; i++){
+		if(xTaskIncrementTick())
+			switch_needed = pdTRUE;
+	}
+
+	if(switch_needed){
+		vTaskSwitchContext();
+	}
+
+	// The next deadline only depends on the previous one, so
+	// interrupt latency does not accumulate as drift
+	next_tick_time += ticks * tick_period;
+
+	timer_program(next_tick_time);
+
+	// Every once in a while the clocksource needs a fresh RTC sample
+#if TIMER_BACKEND == TIMER_BACKEND_GOLDFISH
+	clocksource_poll(cur_time);
+#else
+	clocksource_poll(clocksource_now_ns());
+#endif
+
+	cycles = rdcycle() - start;
+
+	stats.irqs++;
+	stats.isr_cycles += cycles;
+	if(cycles > stats.isr_max_cycles)
+		stats.isr_max_cycles = cycles;
+
+	sched_trace_event(SCHED_TRACE_ISR_EXIT, TICK_TRACE_SRC);
+}
+
+void tick_get_stats(struct tick_stats *st)
+{
+	portENTER_CRITICAL();
+	*st = stats;
+	portEXIT_CRITICAL();
+
+#if TIMER_BACKEND != TIMER_BACKEND_GOLDFISH
+	st->max_lateness = clocksource_cnt_to_ns(st->max_lateness);
+#endif
+}
+
+/*-----------------------------------------------------------*/
+
+#if configUSE_TICKLESS_IDLE
+
+// Stop the periodic tick while the idle task runs: program a single alarm
+// for the time the next task unblocks, sleep in wfi and afterwards tell
+// the kernel how many ticks went by. Every skipped tick is one less round
+// of timer accesses trapping into the hypervisor.
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+	const uint64_t max_idle_ticks = (UINT64_MAX / 2) / tick_period;
+	uint64_t idle_ticks = xExpectedIdleTime, wake_time = 0, cur_time = 0;
+	TickType_t elapsed = 0;
+
+	if(idle_ticks > max_idle_ticks)
+		idle_ticks = max_idle_ticks;
+
+	// Interrupts stay pending while disabled, wfi wakes up regardless
+	portDISABLE_INTERRUPTS();
+
+	// A task might have become ready in the meantime
+	if(eTaskConfirmSleepModeStatus() == eAbortSleep){
+		portENABLE_INTERRUPTS();
+		return;
+	}
+
+	// The pending tick alarm is the first of the idle ticks
+	wake_time = next_tick_time + (idle_ticks - 1) * tick_period;
+	timer_program(wake_time);
+
+	__asm volatile( "wfi" );
+
+	cur_time = timer_now();
+
+	if(cur_time >= wake_time){
+		// The alarm fired, the tick interrupt still pending accounts
+		// for the last tick as soon as interrupts are enabled again
+		elapsed = (TickType_t) (idle_ticks - 1);
+		next_tick_time = wake_time;
+	} else {
+		// Some other interrupt woke us up, count the full ticks that
+		// passed and put the alarm on the next tick boundary
+		if(cur_time >= next_tick_time)
+			elapsed = (TickType_t) ((cur_time - next_tick_time) / tick_period + 1);
+
+		next_tick_time += (uint64_t) elapsed * tick_period;
+		timer_program(next_tick_time);
+	}
+
+	vTaskStepTick(elapsed);
+
+	portENABLE_INTERRUPTS();
+}
+
+#endif /* configUSE_TICKLESS_IDLE */
@@ -0,0 +1,48 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef TICK_H_
+#define TICK_H_
+
+#include <FreeRTOS.h>
+
+#define TICK_RTC_IRQ		11
+#define TICK_RTC_IRQ_PRIO	7
+
+// Where the tick comes from, selected with TIMER_BACKEND in the build
+//  GOLDFISH: Goldfish RTC alarm through the PLIC (IRQ 11)
+//  SBI:      SBI TIME extension, supervisor timer interrupt
+//  SSTC:     stimecmp CSR (Sstc), supervisor timer interrupt
+#define TIMER_BACKEND_GOLDFISH	0
+#define TIMER_BACKEND_SBI		1
+#define TIMER_BACKEND_SSTC		2
+
+#ifndef TIMER_BACKEND
+#define TIMER_BACKEND	TIMER_BACKEND_GOLDFISH
+#endif
+
+struct tick_stats {
+	uint64_t ticks;			// Ticks accounted for by the tick interrupt
+	uint64_t missed;		// Ticks that were replayed because their alarm came late
+	uint64_t max_lateness;	// Worst case alarm lateness in ns
+	uint64_t irqs;			// Tick interrupts handled
+	uint64_t isr_cycles;	// Cycles spent in tick_handle_interrupt() in total
+	uint64_t isr_max_cycles;
+};
+
+// Called by the interrupt handler when the tick alarm went off
+// (PLIC IRQ 11 or supervisor timer interrupt, depending on the backend)
+void tick_handle_interrupt(void);
+
+void tick_get_stats(struct tick_stats *st);
+
+void vPortSetupTimerInterrupt(void);
+
+#if configUSE_TICKLESS_IDLE
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+#endif
+
+#endif /* TICK_H_ */
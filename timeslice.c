@@ -0,0 +1,166 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <stdint.h>
+
+#include "clocksource.h"
+#include "riscv-virt.h"
+#include "sbi.h"
+#include "timeslice.h"
+#include "vendor_csr.h"
+
+#define SSTATUS_SIE		(1 << 1)
+#define SIE_STIE		(1 << 5)
+
+// How often the calibration loop looks at the clock
+#define CAL_CLOCK_EVERY	1024
+
+static uint64_t thresh = TIMESLICE_THRESH;
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t log2_floor(uint64_t v)
+{
+	return v ? 63 - __builtin_clzl(v) : 0;
+}
+
+// Log2 bucket of the largest gap between two rdcycle reads in a window
+static uint32_t cal_window(void)
+{
+	uint64_t first = 0, second = 0, gap = 0, max_gap = 0;
+	uint64_t end = clocksource_now_ns() + TIMESLICE_CAL_WINDOW_NS;
+
+	first = rdcycle();
+	for(uint64_t i = 1; ; i++){
+		second = rdcycle();
+
+		gap = second - first;
+		if(gap > max_gap)
+			max_gap = gap;
+
+		if(!(i % CAL_CLOCK_EVERY)){
+			if(clocksource_now_ns() >= end)
+				break;
+
+			// Do not count the clock read itself
+			second = rdcycle();
+		}
+
+		first = second;
+	}
+
+	return log2_floor(max_gap);
+}
+
+uint64_t timeslice_calibrate(void)
+{
+	uint32_t top[TIMESLICE_CAL_WINDOWS];
+	uint32_t bits = 0;
+
+	for(int w = 0; w < TIMESLICE_CAL_WINDOWS; w++)
+		top[w] = cal_window();
+
+	// Insertion sort for the median
+	for(int i = 1; i < TIMESLICE_CAL_WINDOWS; i++){
+		uint32_t v = top[i];
+		int j = i - 1;
+
+		while(j >= 0 && top[j] > v){
+			top[j + 1] = top[j];
+			j--;
+		}
+		top[j + 1] = v;
+	}
+
+	bits = top[TIMESLICE_CAL_WINDOWS / 2] + 1 + TIMESLICE_CAL_MARGIN_BITS;
+	if(bits > 62)
+		bits = 62;
+
+	thresh = 1UL << bits;
+
+	vSendFormat("[timeslice] jitter up to 2^%u cycles, threshold %lu cycles",
+				top[TIMESLICE_CAL_WINDOWS / 2] + 1, thresh);
+
+	return thresh;
+}
+
+uint64_t timeslice_threshold(void)
+{
+	return thresh;
+}
+
+__attribute__((noinline)) void new_timeslice_rdcycle(void)
+{
+	uint64_t first = 0, second = 0;
+
+	first = rdcycle();
+	while(1) {
+		second = rdcycle();
+
+		if(second-first > thresh)
+			return;
+
+		first = second;
+	}
+}
+
+#if TIMESLICE_WAIT_WFI
+
+// Sleep until the notification shows up. The pending timer interrupt
+// only ends wfi: it is masked in sstatus, so no trap is taken.
+static void wait_wfi(void)
+{
+	uint64_t period = clocksource_ns_to_cnt(TIMESLICE_WFI_PERIOD_NS);
+	uint64_t sstatus = 0;
+
+	__asm volatile(
+		"csrrc %0, sstatus, %1\n"
+		: "=r"(sstatus)
+		: "r"(SSTATUS_SIE)
+		:
+	);
+
+	__asm volatile(
+		"csrrs x0, sie, %0\n"
+		:: "r"(SIE_STIE)
+		:
+	);
+
+	while(!(csr_ctxt_swtch_read() & CSR_CTXT_SWTCH_HAPPENED)){
+		sbi_set_timer(rdtime() + period);
+		__asm volatile("wfi\n");
+	}
+
+	// Programming a deadline far away also clears the pending interrupt
+	sbi_set_timer(UINT64_MAX);
+
+	__asm volatile(
+		"csrrc x0, sie, %0\n"
+		:: "r"(SIE_STIE)
+		:
+	);
+
+	__asm volatile(
+		"csrrs x0, sstatus, %0\n"
+		:: "r"(sstatus & SSTATUS_SIE)
+		:
+	);
+}
+
+#endif /* TIMESLICE_WAIT_WFI */
+
+__attribute__((noinline)) void new_timeslice_ctx_swtch(void)
+{
+	csr_ctxt_swtch_arm();
+
+#if TIMESLICE_WAIT_WFI
+	wait_wfi();
+#else
+	while(!(csr_ctxt_swtch_read() & CSR_CTXT_SWTCH_HAPPENED)){}
+#endif
+
+	csr_ctxt_swtch_clear();
+}
@@ -0,0 +1,63 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef TIMESLICE_H_
+#define TIMESLICE_H_
+
+#include <stdint.h>
+
+#include "tick.h"
+
+// Wait for the start of our next time slice, i.e. until the hypervisor
+// ran somebody else (the adversary) on this core in between
+
+// Gap threshold of new_timeslice_rdcycle() until timeslice_calibrate() ran
+#define TIMESLICE_THRESH 1000000
+
+// Sleep in wfi between checks of the context switch notification instead
+// of spinning, woken up by the supervisor timer. The SBI/Sstc tick
+// backends own that timer, so it is off by default with them.
+#ifndef TIMESLICE_WAIT_WFI
+#if TIMER_BACKEND == TIMER_BACKEND_GOLDFISH && !defined(CLOCKSOURCE_USE_CYCLE)
+#define TIMESLICE_WAIT_WFI 1
+#else
+#define TIMESLICE_WAIT_WFI 0
+#endif
+#endif
+
+// Wakeup period of the wfi wait
+#ifndef TIMESLICE_WFI_PERIOD_NS
+#define TIMESLICE_WFI_PERIOD_NS		100000UL
+#endif
+
+// Calibration of the rdcycle threshold: the largest gap between two
+// rdcycle reads is taken in each of TIMESLICE_CAL_WINDOWS windows. The
+// median of those (so a time slice lost in a few windows does not count)
+// times 2^TIMESLICE_CAL_MARGIN_BITS becomes the threshold.
+#ifndef TIMESLICE_CAL_WINDOWS
+#define TIMESLICE_CAL_WINDOWS		7
+#endif
+
+#ifndef TIMESLICE_CAL_WINDOW_NS
+#define TIMESLICE_CAL_WINDOW_NS		500000UL
+#endif
+
+#ifndef TIMESLICE_CAL_MARGIN_BITS
+#define TIMESLICE_CAL_MARGIN_BITS	3
+#endif
+
+// Calibrate the rdcycle gap threshold, returns it in cycles
+uint64_t timeslice_calibrate(void);
+
+uint64_t timeslice_threshold(void);
+
+// Spin on rdcycle until two reads are further apart than the threshold
+void new_timeslice_rdcycle(void);
+
+// Wait for the context switch notification of CSR 0x5DB
+void new_timeslice_ctx_swtch(void);
+
+#endif /* TIMESLICE_H_ */
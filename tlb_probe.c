@@ -0,0 +1,203 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "riscv-virt.h"
+#include "tlb_probe.h"
+#include "xorshift.h"
+
+// Cache line size used to spread the chain over the cache sets
+#define SWEEP_OFFSET_STEP	64
+
+// Accesses per timed run of the sweep, so short chains are walked often
+#define SWEEP_MIN_ACCESSES	2048
+
+#define SWEEP_REPS			5
+
+// Page order of the chain currently being built
+static uint16_t order[TLB_PROBE_MAX_PAGES];
+
+/*-----------------------------------------------------------*/
+
+static inline uint8_t *element(const struct tlb_probe_cfg *cfg, uint64_t page_size, uint64_t idx)
+{
+	uint64_t offset = (cfg->offset + idx * cfg->offset_step) % page_size;
+
+	// Keep the pointers naturally aligned
+	offset &= ~(uint64_t) (sizeof(void *) - 1);
+
+	return cfg->base + idx * cfg->stride * page_size + offset;
+}
+
+void *tlb_probe_build(const struct tlb_probe_cfg *cfg, uint64_t num_buf_pages)
+{
+	uint64_t page_size = cfg->page_size ? cfg->page_size : TLB_PROBE_PAGE_SIZE;
+	uint64_t n = cfg->num_pages, seed = cfg->seed ? cfg->seed : 0x9E3779B97F4A7C15UL;
+	uint64_t stride = cfg->stride ? cfg->stride : 1;
+
+	if(!n || n > TLB_PROBE_MAX_PAGES || (n - 1) * stride >= num_buf_pages)
+		return NULL;
+
+	for(uint64_t i = 0; i < n; i++){
+		switch(cfg->pattern){
+			case TLB_PATTERN_DESCENDING:
+				order[i] = (uint16_t) (n - 1 - i);
+				break;
+			case TLB_PATTERN_ASCENDING:
+			case TLB_PATTERN_RANDOM:
+			default:
+				order[i] = (uint16_t) i;
+				break;
+		}
+	}
+
+	// Fisher-Yates
+	if(cfg->pattern == TLB_PATTERN_RANDOM){
+		for(uint64_t i = n - 1; i > 0; i--){
+			uint64_t j = xorshift64(&seed) % (i + 1);
+			uint16_t tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+	}
+
+	if(cfg->reverse){
+		for(uint64_t i = 0; i < n / 2; i++){
+			uint16_t tmp = order[i];
+			order[i] = order[n - 1 - i];
+			order[n - 1 - i] = tmp;
+		}
+	}
+
+	struct tlb_probe_cfg c = *cfg;
+	c.stride = stride;
+
+	// Close the cycle: the last element points back to the first one
+	for(uint64_t i = 0; i < n; i++)
+		*(void **) element(&c, page_size, order[i]) = element(&c, page_size, order[(i + 1) % n]);
+
+	return element(&c, page_size, order[0]);
+}
+
+uint64_t tlb_probe_time(void *head, uint64_t num_pages, uint64_t passes, uint32_t reps)
+{
+	uint64_t best = UINT64_MAX, start = 0, end = 0;
+	uint64_t accesses = num_pages * passes;
+
+	// Warm up caches and TLB with one pass
+	head = tlb_chase(head, num_pages);
+
+	for(uint32_t r = 0; r < reps; r++){
+		start = rdcycle();
+		head = tlb_chase(head, accesses);
+		end = rdcycle();
+
+		if(end - start < best)
+			best = end - start;
+	}
+
+	return (best * 16) / accesses;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t sweep_point(uint8_t *base, uint64_t num_buf_pages, uint64_t n, uint64_t stride)
+{
+	struct tlb_probe_cfg cfg = {
+		.base = base,
+		.page_size = TLB_PROBE_PAGE_SIZE,
+		.num_pages = n,
+		.stride = stride,
+		.offset = 0,
+		.offset_step = SWEEP_OFFSET_STEP,
+		.pattern = TLB_PATTERN_RANDOM,
+		.seed = 0,
+		.reverse = 0,
+	};
+	uint64_t passes = (SWEEP_MIN_ACCESSES + n - 1) / n;
+	void *head = tlb_probe_build(&cfg, num_buf_pages);
+
+	if(!head)
+		return 0;
+
+	return tlb_probe_time(head, n, passes, SWEEP_REPS);
+}
+
+// Smallest chain length with a latency above the knee, 0 if there is none
+static uint64_t find_knee(uint8_t *base, uint64_t num_buf_pages, uint64_t stride,
+						  uint64_t hit_x16, uint64_t *miss_x16)
+{
+	uint64_t max_n = (num_buf_pages - 1) / stride + 1, lat = 0;
+
+	if(max_n > TLB_PROBE_MAX_PAGES)
+		max_n = TLB_PROBE_MAX_PAGES;
+
+	for(uint64_t n = 1; n <= max_n; n++){
+		lat = sweep_point(base, num_buf_pages, n, stride);
+
+		if(lat * 100 > hit_x16 * TLB_PROBE_KNEE_PCT){
+			if(miss_x16)
+				*miss_x16 = lat;
+			return n;
+		}
+	}
+
+	return 0;
+}
+
+void tlb_probe_sweep(uint8_t *base, uint64_t num_buf_pages, struct tlb_sweep_result *res)
+{
+	uint64_t knee = 0, lat = 0;
+
+	res->capacity = res->ways = res->sets = 0;
+	res->miss_x16 = 0;
+
+	// Hit latency: a handful of pages always fits
+	res->hit_x16 = UINT64_MAX;
+	for(uint64_t n = 1; n <= 4 && n <= num_buf_pages; n++){
+		lat = sweep_point(base, num_buf_pages, n, 1);
+		if(lat < res->hit_x16)
+			res->hit_x16 = lat;
+	}
+
+	// Capacity: consecutive pages are spread over all sets
+	knee = find_knee(base, num_buf_pages, 1, res->hit_x16, &res->miss_x16);
+	if(!knee){
+		vSendFormat("[tlb_sweep] no knee up to %lu pages, buffer too small",
+					num_buf_pages);
+		return;
+	}
+	res->capacity = knee - 1;
+	res->ways = res->capacity;
+
+	vSendFormat("[tlb_sweep] capacity: %lu entries (hit: %lu/16, miss: %lu/16 cycles)",
+				res->capacity, res->hit_x16, res->miss_x16);
+
+	// Associativity: doubling the stride halves the usable entries until
+	// the stride reaches the number of sets. From there on all pages of
+	// the chain compete for the ways of a single set.
+	uint64_t prev = res->capacity;
+	for(uint64_t stride = 2; stride <= num_buf_pages / 2; stride <<= 1){
+		knee = find_knee(base, num_buf_pages, stride, res->hit_x16, NULL);
+
+		vSendFormat("[tlb_sweep] stride %lu: knee at %lu pages", stride, knee);
+
+		// Chain got too short to tell
+		if(!knee)
+			break;
+
+		res->ways = knee - 1;
+		if(knee - 1 > prev / 2)
+			break;
+
+		prev = knee - 1;
+	}
+
+	if(!res->ways)
+		res->ways = 1;
+	res->sets = res->capacity / res->ways;
+
+	vSendFormat("[tlb_sweep] %lu ways, %lu sets", res->ways, res->sets);
+}
@@ -0,0 +1,71 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef TLB_PROBE_H_
+#define TLB_PROBE_H_
+
+#include <stdint.h>
+
+// Parameterized TLB probes
+//
+// A probe is a cyclic pointer chain through num_pages pages of a buffer,
+// walked by tlb_chase() in tlb_access.S (which lives in the ISPM). Every
+// page holds exactly one element of the chain.
+
+#define TLB_PROBE_PAGE_SIZE		4096UL
+
+// Most pages a chain can span
+#ifndef TLB_PROBE_MAX_PAGES
+#define TLB_PROBE_MAX_PAGES		512
+#endif
+
+// A latency above KNEE_PCT percent of the hit latency counts as TLB miss
+#ifndef TLB_PROBE_KNEE_PCT
+#define TLB_PROBE_KNEE_PCT		130
+#endif
+
+enum tlb_pattern {
+	TLB_PATTERN_ASCENDING,
+	TLB_PATTERN_DESCENDING,
+	TLB_PATTERN_RANDOM,		// Random permutation, defeats prefetchers
+};
+
+struct tlb_probe_cfg {
+	uint8_t *base;			// Start of the buffer, page aligned
+	uint64_t page_size;		// Size of the pages to probe (0 = 4 KiB)
+	uint64_t num_pages;		// Number of pages in the chain
+	uint64_t stride;		// Distance between pages, in pages: a stride of
+							// #sets keeps all accesses in one TLB set
+	uint64_t offset;		// Byte offset of the access into the first page
+	uint64_t offset_step;	// Added to the offset from page to page, spreads
+							// the accesses over the cache sets
+	enum tlb_pattern pattern;
+	uint64_t seed;			// For TLB_PATTERN_RANDOM
+	int reverse;			// Walk the pattern backwards
+};
+
+struct tlb_sweep_result {
+	uint64_t capacity;		// Entries of the first level TLB (0 = no knee found)
+	uint64_t ways;			// Associativity (== capacity if fully associative)
+	uint64_t sets;
+	uint64_t hit_x16;		// Cycles per access * 16 when hitting
+	uint64_t miss_x16;		// Cycles per access * 16 right after the knee
+};
+
+// Build the chain, returns its head or NULL if it does not fit num_buf_pages
+void *tlb_probe_build(const struct tlb_probe_cfg *cfg, uint64_t num_buf_pages);
+
+// Walk a chain of num_pages pages passes times, returns the best
+// of reps runs in cycles per access * 16
+uint64_t tlb_probe_time(void *head, uint64_t num_pages, uint64_t passes, uint32_t reps);
+
+// Find capacity and associativity of the TLB with chains of increasing size
+void tlb_probe_sweep(uint8_t *base, uint64_t num_buf_pages, struct tlb_sweep_result *res);
+
+// Implemented in tlb_access.S
+void *tlb_chase(void *head, uint64_t num_accesses);
+
+#endif /* TLB_PROBE_H_ */
@@ -0,0 +1,342 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+//
+// Host-side decoder for the binary record stream of the isolation
+// benchmark (see bench_record.h). Reads a raw UART capture from a file
+// or stdin and writes the rounds as CSV to stdout. Text lines and
+// damaged frames in the capture are skipped. Runs of the leakage test
+// mark each round as a switch or a baseline round, all other rounds are
+// switch rounds.
+//
+// With -t it writes the scheduler trace (see sched_trace.h) as a timeline
+// instead: one line per event, cycles relative to the first event.
+//
+// Usage: record_decode [-t] [capture.bin] > rounds.csv
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_RECORD_HOST
+#include "../bench_record.h"
+
+static unsigned long frames_ok = 0, frames_bad = 0;
+
+// Rounds of the two classes, the diff to prev stays within a class
+static const char *class_names[] = { "switch", "baseline" };
+static uint64_t last_value[2] = { 0, 0 };
+static int class_bit = 0;
+
+// Timeline mode
+static int timeline = 0;
+static char task_names[256][32];
+static uint64_t first_cycles = 0, last_cycles = 0;
+static int have_cycles = 0;
+
+// Event types of sched_trace.h
+static const char *event_names[] = {
+	[1] = "switch_in",
+	[2] = "switch_out",
+	[3] = "isr_enter",
+	[4] = "isr_exit",
+	[5] = "yield",
+};
+
+static uint16_t fletcher16(const uint8_t *buf, uint32_t len)
+{
+	uint32_t a = 0, b = 0;
+
+	for(uint32_t i = 0; i < len; i++){
+		a = (a + buf[i]) % 255;
+		b = (b + a) % 255;
+	}
+
+	return (uint16_t) ((b << 8) | a);
+}
+
+// Returns the number of bytes consumed, 0 on a truncated varint
+static uint32_t get_varint(const uint8_t *buf, uint32_t len, uint64_t *val)
+{
+	uint64_t res = 0;
+
+	for(uint32_t i = 0; i < len && i < 10; i++){
+		res |= (uint64_t) (buf[i] & 0x7f) << (7 * i);
+		if(!(buf[i] & 0x80)){
+			*val = res;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+static inline int64_t unzigzag(uint64_t val)
+{
+	return (int64_t) (val >> 1) ^ -(int64_t) (val & 1);
+}
+
+static void decode_meta(const uint8_t *p, uint32_t len)
+{
+	uint64_t key = 0, value = 0;
+	uint32_t n = 0;
+
+	if(!(n = get_varint(p, len, &key)) || !get_varint(p + n, len - n, &value)){
+		frames_bad++;
+		return;
+	}
+
+	switch(key){
+		case BENCH_META_VERSION:
+			// Start of a run
+			class_bit = 0;
+			if(value != BENCH_RECORD_VERSION)
+				fprintf(stderr, "warning: stream version %lu, decoder version %u\n",
+						(unsigned long) value, BENCH_RECORD_VERSION);
+			break;
+		case BENCH_META_ROUNDS:
+			fprintf(stderr, "rounds: %lu\n", (unsigned long) value);
+			break;
+		case BENCH_META_PAGES:
+			fprintf(stderr, "pages: %lu\n", (unsigned long) value);
+			break;
+		case BENCH_META_TIMER_OVERHEAD:
+			fprintf(stderr, "timer overhead: %lu cycles\n", (unsigned long) value);
+			break;
+		case BENCH_META_PAGE_SIZE:
+			fprintf(stderr, "guest page size: %lu KiB\n", (unsigned long) value >> 10);
+			break;
+		case BENCH_META_CLASS_BIT:
+			class_bit = (value != 0);
+			break;
+		default:
+			fprintf(stderr, "meta %lu: %lu\n", (unsigned long) key, (unsigned long) value);
+			break;
+	}
+}
+
+static void decode_rounds(const uint8_t *p, uint32_t len)
+{
+	uint64_t round = 0, zz = 0, value = 0, cycles = 0;
+	uint32_t n = 0, pos = 0, cls = 0;
+
+	if(!(pos = get_varint(p, len, &round))){
+		frames_bad++;
+		return;
+	}
+
+	while(pos < len){
+		if(!(n = get_varint(p + pos, len - pos, &zz))){
+			frames_bad++;
+			return;
+		}
+		pos += n;
+
+		value += (uint64_t) unzigzag(zz);
+
+		cycles = class_bit ? value >> 1 : value;
+		cls = class_bit ? (uint32_t) (value & 1) : 0;
+
+		// Same columns as the old text output: cycles and diff to prev
+		printf("%lu,%s,%lu,%ld\n", (unsigned long) round, class_names[cls],
+				(unsigned long) cycles, (long) (cycles - last_value[cls]));
+		last_value[cls] = cycles;
+		round++;
+	}
+}
+
+static void decode_task(const uint8_t *p, uint32_t len)
+{
+	uint64_t num = 0;
+	uint32_t n = 0;
+
+	if(!(n = get_varint(p, len, &num)) || num >= 256){
+		frames_bad++;
+		return;
+	}
+
+	len -= n;
+	if(len >= sizeof(task_names[0]))
+		len = sizeof(task_names[0]) - 1;
+
+	memcpy(task_names[num], p + n, len);
+	task_names[num][len] = '\0';
+}
+
+static void print_event(uint64_t cycles, uint8_t type, uint8_t arg)
+{
+	const char *name = (type < sizeof(event_names) / sizeof(event_names[0])) ? event_names[type] : NULL;
+
+	if(!have_cycles){
+		first_cycles = last_cycles = cycles;
+		have_cycles = 1;
+	}
+
+	printf("%lu,%lu,", (unsigned long) (cycles - first_cycles),
+			(unsigned long) (cycles - last_cycles));
+	last_cycles = cycles;
+
+	if(name)
+		printf("%s,", name);
+	else
+		printf("0x%02x,", type);
+
+	// Switches carry a task number, interrupts the source (0 is the timer)
+	if(type == 1 || type == 2)
+		printf("%u,%s\n", arg, task_names[arg][0] ? task_names[arg] : "?");
+	else if(type == 3 || type == 4)
+		printf("%u,%s\n", arg, arg ? "irq" : "timer");
+	else
+		printf("%u,\n", arg);
+}
+
+static void decode_trace(const uint8_t *p, uint32_t len)
+{
+	uint64_t cycles = 0, zz = 0;
+	uint32_t n = 0, pos = 0;
+	uint8_t type = 0, arg = 0;
+
+	if(!(pos = get_varint(p, len, &cycles))){
+		frames_bad++;
+		return;
+	}
+
+	while(pos < len){
+		if(len - pos < 3){
+			frames_bad++;
+			return;
+		}
+		type = p[pos++];
+		arg = p[pos++];
+
+		if(!(n = get_varint(p + pos, len - pos, &zz))){
+			frames_bad++;
+			return;
+		}
+		pos += n;
+
+		cycles += (uint64_t) unzigzag(zz);
+		print_event(cycles, type, arg);
+	}
+}
+
+static void decode_frame(const uint8_t *frame)
+{
+	uint8_t type = frame[2], len = frame[3];
+	const uint8_t *payload = &frame[BENCH_RECORD_HDR_SIZE];
+	uint64_t total = 0;
+
+	frames_ok++;
+
+	switch(type){
+		case BENCH_RECORD_META:
+			decode_meta(payload, len);
+			break;
+		case BENCH_RECORD_ROUNDS:
+			if(!timeline)
+				decode_rounds(payload, len);
+			break;
+		case BENCH_RECORD_TASK:
+			decode_task(payload, len);
+			break;
+		case BENCH_RECORD_TRACE:
+			if(timeline)
+				decode_trace(payload, len);
+			break;
+		case BENCH_RECORD_END:
+			if(get_varint(payload, len, &total))
+				fprintf(stderr, "end of run after %lu rounds\n", (unsigned long) total);
+			break;
+		default:
+			fprintf(stderr, "skipping unknown frame type 0x%02x\n", type);
+			break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t frame[BENCH_RECORD_HDR_SIZE + BENCH_RECORD_MAX_PAYLOAD + BENCH_RECORD_CSUM_SIZE];
+	// Bytes of a damaged frame that are scanned again, they and the frame
+	// being collected never add up to more than one frame
+	uint8_t again[sizeof(frame)];
+	uint32_t again_pos = 0, again_len = 0, rest = 0;
+	uint32_t have = 0, need = BENCH_RECORD_HDR_SIZE;
+	FILE *in = stdin;
+	int c = 0;
+
+	if(argc > 1 && !strcmp(argv[1], "-t")){
+		timeline = 1;
+		argc--;
+		argv++;
+	}
+
+	if(argc > 1 && !(in = fopen(argv[1], "rb"))){
+		perror(argv[1]);
+		return 1;
+	}
+
+	if(timeline)
+		printf("cycles,delta,event,arg,task\n");
+	else
+		printf("round,class,cycles,diff_to_prev\n");
+
+	while(1){
+		c = (again_pos < again_len) ? again[again_pos++] : fgetc(in);
+
+		if(c == EOF){
+			// A frame cut off by the end of the capture is damaged too
+			if(have < 2)
+				break;
+		} else {
+			// Hunt for the sync bytes
+			if(have == 0 && c != BENCH_RECORD_SYNC0)
+				continue;
+			if(have == 1 && c != BENCH_RECORD_SYNC1){
+				have = (c == BENCH_RECORD_SYNC0);
+				continue;
+			}
+
+			frame[have++] = (uint8_t) c;
+
+			if(have == BENCH_RECORD_HDR_SIZE)
+				need = BENCH_RECORD_HDR_SIZE + frame[3] + BENCH_RECORD_CSUM_SIZE;
+
+			if(have < need)
+				continue;
+
+			uint32_t len = frame[3];
+			uint16_t csum = (uint16_t) (frame[BENCH_RECORD_HDR_SIZE + len] |
+									   (frame[BENCH_RECORD_HDR_SIZE + len + 1] << 8));
+
+			if(fletcher16(&frame[2], len + 2) == csum){
+				decode_frame(frame);
+				have = 0;
+				need = BENCH_RECORD_HDR_SIZE;
+				continue;
+			}
+		}
+
+		frames_bad++;
+
+		// A damaged length byte would swallow the frames behind it, so
+		// hunt for the next sync right after this one
+		rest = again_len - again_pos;
+		memmove(&again[have - 1], &again[again_pos], rest);
+		memcpy(again, &frame[1], have - 1);
+		again_pos = 0;
+		again_len = have - 1 + rest;
+
+		have = 0;
+		need = BENCH_RECORD_HDR_SIZE;
+	}
+
+	fprintf(stderr, "%lu frames decoded, %lu damaged\n", frames_ok, frames_bad);
+
+	if(in != stdin)
+		fclose(in);
+
+	return frames_bad ? 2 : 0;
+}
@@ -0,0 +1,74 @@
+#!/bin/sh
+# Copyright 2023 ETH Zurich and University of Bologna.
+# Licensed under the Apache License, Version 2.0, see LICENSE for details.
+# SPDX-License-Identifier: Apache-2.0
+#
+# Christopher Reinwardt <creinwar@student.ethz.ch>
+#
+# Show how full the ISPM and DSPM are and what lives in them, including
+# the boot and interrupt stacks. Exits non-zero if a scratchpad overflows.
+#
+# Usage: spm_report.sh <nm> <elf>
+
+if [ $# -ne 2 ]; then
+	echo "Usage: $0 <nm> <elf>" >&2
+	exit 2
+fi
+
+NM=$1
+ELF=$2
+
+"$NM" -n -S "$ELF" | awk '
+function hex(s,    i, c, v) {
+	v = 0
+	s = tolower(s)
+	for (i = 1; i <= length(s); i++) {
+		c = index("0123456789abcdef", substr(s, i, 1)) - 1
+		v = v * 16 + c
+	}
+	return v
+}
+
+# Symbols without a size (linker script symbols) have three fields
+NF == 3 { sym[$3] = hex($1) }
+NF == 4 { sym[$4] = hex($1); n++; addr[n] = hex($1); size[n] = hex($2); name[n] = $4 }
+
+# Linker script regions without a symbol of their own
+function region(rname, start, end) {
+	if ((start in sym) && (end in sym)) {
+		nr++
+		raddr[nr] = sym[start]
+		rsize[nr] = sym[end] - sym[start]
+		rlabel[nr] = rname
+	}
+}
+
+function report(spm, start, end, total,    used, i) {
+	used = end - start
+	printf "%s: %d / %d bytes (%d%%)\n", spm, used, total, (used * 100) / total
+	for (i = 1; i <= nr; i++)
+		if (raddr[i] >= start && raddr[i] < end)
+			printf "  %6d  %s\n", rsize[i], rlabel[i]
+	for (i = 1; i <= n; i++)
+		if (addr[i] >= start && addr[i] < end && size[i] > 0)
+			printf "  %6d  %s\n", size[i], name[i]
+	if (used > total) {
+		printf "%s overflows by %d bytes\n", spm, used - total
+		return 1
+	}
+	return 0
+}
+
+END {
+	if (!("__ispm_start" in sym) || !("__dspm_start" in sym)) {
+		print "No scratchpad symbols found" > "/dev/stderr"
+		exit 2
+	}
+
+	region("(boot stack)", "__stack_start", "_stack_top")
+	region("(interrupt stack)", "__isr_stack_start", "__freertos_irq_stack_top")
+
+	err = report("ISPM", sym["__ispm_start"], sym["__ispm_end"], sym["__ispm_size"])
+	err += report("DSPM", sym["__dspm_start"], sym["__dspm_end"], sym["__dspm_size"])
+	exit err ? 1 : 0
+}'
@@ -0,0 +1,66 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "bench_stats.h"
+#include "riscv-virt.h"
+#include "trap_bench.h"
+
+#if TRAP_BENCH
+
+volatile uint64_t trap_bench_stamp = 0;
+
+static struct bench_stats stats;
+
+/*-----------------------------------------------------------*/
+
+// Raise a supervisor software interrupt (what a yield does) and measure
+// the cycles until the C handler runs
+static void trap_bench_run(const char *tag, int vectored)
+{
+	uint64_t start = 0;
+
+	bench_stats_reset(&stats);
+	vSetTrapMode(vectored);
+
+	for(int i = 0; i < TRAP_BENCH_ROUNDS; i++){
+		trap_bench_stamp = 0;
+
+		start = rdcycle();
+		__asm volatile(
+			"csrrs x0, sip, %0\n"
+			:: "r"(1 << 1)
+			:
+		);
+
+		// The trap is taken at the latest a few instructions later
+		while(!trap_bench_stamp){}
+
+		bench_stats_add(&stats, trap_bench_stamp - start);
+	}
+
+	bench_stats_report(&stats, tag);
+}
+
+void trap_bench_task(void *pvParameters)
+{
+	(void) pvParameters;
+
+	vSendString("[trap_bench] Starting");
+
+	trap_bench_run("trap entry direct", 0);
+	trap_bench_run("trap entry vectored", 1);
+
+	vSetTrapMode(TRAP_VECTORED);
+
+	vSendString("[trap_bench] Done!");
+
+	vTaskDelete(NULL);
+}
+
+#endif /* TRAP_BENCH */
@@ -0,0 +1,44 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef TRAP_BENCH_H_
+#define TRAP_BENCH_H_
+
+#include <stdint.h>
+
+#include "riscv-virt.h"
+
+// Compare the entry-to-handler latency of the direct and the vectored
+// stvec mode. Replaces the bare-metal probe run when enabled.
+#ifndef TRAP_BENCH
+#define TRAP_BENCH 0
+#endif
+
+#ifndef TRAP_BENCH_ROUNDS
+#define TRAP_BENCH_ROUNDS 10000
+#endif
+
+#if TRAP_BENCH
+
+extern volatile uint64_t trap_bench_stamp;
+
+// First thing every C level interrupt handler does
+static inline void trap_bench_mark(void)
+{
+	trap_bench_stamp = rdcycle();
+}
+
+void trap_bench_task(void *pvParameters);
+
+#else
+
+static inline void trap_bench_mark(void)
+{
+}
+
+#endif /* TRAP_BENCH */
+
+#endif /* TRAP_BENCH_H_ */
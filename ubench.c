@@ -0,0 +1,153 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include "ubench.h"
+
+// Cycle read pairs the overhead is the minimum of
+#define CALIBRATE_ROUNDS	256
+
+struct ubench {
+	const char *name;
+	ubench_fn_t fn;
+	void *arg;
+};
+
+static struct ubench benches[UBENCH_MAX];
+static uint32_t num_benches = 0;
+
+static uint64_t overhead = 0;
+static int calibrated = 0;
+
+static uint64_t samples[UBENCH_SAMPLES];
+static uint64_t devs[UBENCH_SAMPLES];
+
+static void sort(uint64_t *v, uint32_t num)
+{
+	uint64_t tmp = 0;
+	uint32_t j = 0;
+
+	for(uint32_t i = 1; i < num; i++){
+		tmp = v[i];
+		for(j = i; j > 0 && v[j - 1] > tmp; j--)
+			v[j] = v[j - 1];
+		v[j] = tmp;
+	}
+}
+
+// Cycles of iters iterations without the overhead of the cycle reads
+static uint64_t sample(ubench_fn_t fn, void *arg, uint64_t iters)
+{
+	uint64_t start = 0, end = 0;
+
+	start = ubench_cycles();
+	fn(arg, iters);
+	end = ubench_cycles();
+
+	return (end - start > overhead) ? end - start - overhead : 0;
+}
+
+/*-----------------------------------------------------------*/
+
+uint64_t ubench_calibrate(void)
+{
+	uint64_t start = 0, end = 0, min = UINT64_MAX;
+
+	// Anything above the minimum is an interrupt or a stall
+	for(uint32_t i = 0; i < CALIBRATE_ROUNDS; i++){
+		start = ubench_cycles();
+		end = ubench_cycles();
+
+		if(end - start < min)
+			min = end - start;
+	}
+
+	overhead = min;
+	calibrated = 1;
+
+	vSendFormat("[ubench] timer overhead: %lu cycles", overhead);
+
+	return overhead;
+}
+
+uint64_t ubench_overhead(void)
+{
+	return overhead;
+}
+
+int ubench_register(const char *name, ubench_fn_t fn, void *arg)
+{
+	if(num_benches == UBENCH_MAX){
+		vSendFormat("[ubench] no slot left for %s", name);
+		return -1;
+	}
+
+	benches[num_benches++] = (struct ubench) { .name = name, .fn = fn, .arg = arg };
+
+	return 0;
+}
+
+void ubench_run(ubench_fn_t fn, void *arg, struct ubench_result *res)
+{
+	uint64_t iters = 1, median = 0, mad = 0, limit = 0, sum = 0;
+	uint32_t kept = 0;
+
+	if(!calibrated)
+		ubench_calibrate();
+
+	// Long enough samples, this also warms up caches and predictors
+	while(iters < UBENCH_MAX_ITERS && sample(fn, arg, iters) < UBENCH_MIN_CYCLES)
+		iters <<= 1;
+
+	for(uint32_t i = 0; i < UBENCH_WARMUP; i++)
+		sample(fn, arg, iters);
+
+	for(uint32_t i = 0; i < UBENCH_SAMPLES; i++)
+		samples[i] = sample(fn, arg, iters);
+
+	sort(samples, UBENCH_SAMPLES);
+	median = samples[UBENCH_SAMPLES / 2];
+
+	// Median absolute deviation, robust against the outliers themselves
+	for(uint32_t i = 0; i < UBENCH_SAMPLES; i++)
+		devs[i] = (samples[i] > median) ? samples[i] - median : median - samples[i];
+	sort(devs, UBENCH_SAMPLES);
+	mad = devs[UBENCH_SAMPLES / 2];
+
+	// Interrupts and preemption only ever add cycles, so only the upper
+	// end is cut. The samples are sorted, the median is always kept.
+	limit = median + UBENCH_MAD_K * (mad ? mad : 1);
+	for(kept = 0; kept < UBENCH_SAMPLES && samples[kept] <= limit; kept++)
+		sum += samples[kept];
+
+	res->iters = iters;
+	res->samples = kept;
+	res->outliers = UBENCH_SAMPLES - kept;
+	res->min_x100 = samples[0] * 100 / iters;
+	res->median_x100 = median * 100 / iters;
+	res->mean_x100 = sum * 100 / (kept * iters);
+	res->max_x100 = samples[kept - 1] * 100 / iters;
+}
+
+void ubench_run_all(void)
+{
+	struct ubench_result res;
+
+	for(uint32_t i = 0; i < num_benches; i++){
+		ubench_run(benches[i].fn, benches[i].arg, &res);
+		ubench_report(benches[i].name, &res);
+	}
+}
+
+void ubench_report(const char *name, const struct ubench_result *res)
+{
+	vSendFormat("[ubench] %-16s %lu.%02lu cycles/iter (min %lu.%02lu, mean %lu.%02lu, max %lu.%02lu), "
+				"%lu iters x %u samples, %u outliers", name,
+				res->median_x100 / 100, res->median_x100 % 100,
+				res->min_x100 / 100, res->min_x100 % 100,
+				res->mean_x100 / 100, res->mean_x100 % 100,
+				res->max_x100 / 100, res->max_x100 % 100,
+				res->iters, res->samples, res->outliers);
+}
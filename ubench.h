@@ -0,0 +1,93 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef UBENCH_H_
+#define UBENCH_H_
+
+#include <stdint.h>
+
+#include "riscv-virt.h"
+
+// Micro-benchmark harness
+//
+// A benchmark is a function that runs its kernel iters times in a row.
+// ubench_run() warms it up, doubles the iteration count until one sample
+// takes at least UBENCH_MIN_CYCLES, takes UBENCH_SAMPLES samples, subtracts
+// the calibrated overhead of the cycle reads from each, drops outliers
+// above median + UBENCH_MAD_K * MAD and reports cycles per iteration:
+//
+//   [ubench] <name> <median> cycles/iter (min, mean, max), iters x samples, outliers
+
+#ifndef UBENCH_MAX
+#define UBENCH_MAX			16
+#endif
+
+#ifndef UBENCH_SAMPLES
+#define UBENCH_SAMPLES		64
+#endif
+
+// Discarded samples before the measurement
+#ifndef UBENCH_WARMUP
+#define UBENCH_WARMUP		4
+#endif
+
+// Shortest sample, makes the cycle read overhead and its jitter negligible
+#ifndef UBENCH_MIN_CYCLES
+#define UBENCH_MIN_CYCLES	20000
+#endif
+
+#ifndef UBENCH_MAX_ITERS
+#define UBENCH_MAX_ITERS	(1UL << 20)
+#endif
+
+#ifndef UBENCH_MAD_K
+#define UBENCH_MAD_K		5
+#endif
+
+typedef void (*ubench_fn_t)(void *arg, uint64_t iters);
+
+struct ubench_result {
+	uint64_t iters;				// Per sample
+	uint32_t samples;			// Kept after outlier rejection
+	uint32_t outliers;
+	uint64_t min_x100;			// Cycles per iteration * 100
+	uint64_t median_x100;
+	uint64_t mean_x100;
+	uint64_t max_x100;
+};
+
+// Cycle counter between fences, so earlier memory accesses are done and
+// later ones have not started yet
+static inline uint64_t ubench_cycles(void)
+{
+	uint64_t cyc = 0;
+	__asm volatile(
+		"fence iorw, iorw\n"
+		"csrrs %0, cycle, x0\n"
+		"fence iorw, iorw\n"
+		: "=r"(cyc)
+		:: "memory"
+	);
+	return cyc;
+}
+
+// Measure the overhead of a ubench_cycles() pair, done once before the
+// first run. Returns the overhead in cycles.
+uint64_t ubench_calibrate(void);
+
+uint64_t ubench_overhead(void);
+
+// Returns non-zero if the table is full
+int ubench_register(const char *name, ubench_fn_t fn, void *arg);
+
+void ubench_run(ubench_fn_t fn, void *arg, struct ubench_result *res);
+
+// Run and report every registered benchmark
+void ubench_run_all(void);
+
+void ubench_report(const char *name, const struct ubench_result *res);
+
+#endif /* UBENCH_H_ */
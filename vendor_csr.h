@@ -0,0 +1,60 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef VENDOR_CSR_H_
+#define VENDOR_CSR_H_
+
+#include <stdint.h>
+
+// Vendor CSRs of the hypervisor / core under test
+
+// Context switch notification: arming it (bit 1) makes the hypervisor
+// set bit 0 once another VM ran on this core
+#define CSR_CTXT_SWTCH				0x5DB
+#define CSR_CTXT_SWTCH_HAPPENED		(1UL << 0)
+#define CSR_CTXT_SWTCH_ARM			(1UL << 1)
+
+// TLB dump trigger: the value is decremented on every context switch,
+// dumping stops when it reaches zero
+#define CSR_TLB_DUMP				0x802
+
+static inline uint64_t csr_ctxt_swtch_read(void)
+{
+	uint64_t val = 0;
+	__asm volatile(
+		"csrrs %0, 0x5DB, x0\n"
+		: "=r"(val)
+		::
+	);
+	return val;
+}
+
+static inline void csr_ctxt_swtch_arm(void)
+{
+	__asm volatile(
+		"csrrsi x0, 0x5DB, 2\n"
+		:::
+	);
+}
+
+static inline void csr_ctxt_swtch_clear(void)
+{
+	__asm volatile(
+		"csrrw x0, 0x5DB, x0\n"
+		:::
+	);
+}
+
+static inline void csr_tlb_dump_trigger(uint64_t switches)
+{
+	__asm volatile(
+		"csrrw x0, 0x802, %0\n"
+		:: "r"(switches)
+		:
+	);
+}
+
+#endif /* VENDOR_CSR_H_ */
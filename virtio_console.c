@@ -0,0 +1,223 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#include <string.h>
+
+#include "riscv-virt.h"
+#include "virtio_console.h"
+
+// virtio-mmio registers
+#define VIRTIO_MMIO_MAGIC_VALUE			0x000
+#define VIRTIO_MMIO_VERSION				0x004
+#define VIRTIO_MMIO_DEVICE_ID			0x008
+#define VIRTIO_MMIO_DEVICE_FEATURES		0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL	0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES		0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL	0x024
+#define VIRTIO_MMIO_GUEST_PAGE_SIZE		0x028	// Legacy only
+#define VIRTIO_MMIO_QUEUE_SEL			0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX		0x034
+#define VIRTIO_MMIO_QUEUE_NUM			0x038
+#define VIRTIO_MMIO_QUEUE_ALIGN			0x03c	// Legacy only
+#define VIRTIO_MMIO_QUEUE_PFN			0x040	// Legacy only
+#define VIRTIO_MMIO_QUEUE_READY			0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY		0x050
+#define VIRTIO_MMIO_STATUS				0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW		0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH		0x084
+#define VIRTIO_MMIO_QUEUE_DRIVER_LOW	0x090
+#define VIRTIO_MMIO_QUEUE_DRIVER_HIGH	0x094
+#define VIRTIO_MMIO_QUEUE_DEVICE_LOW	0x0a0
+#define VIRTIO_MMIO_QUEUE_DEVICE_HIGH	0x0a4
+
+#define VIRTIO_MAGIC					0x74726976	// "virt"
+#define VIRTIO_ID_CONSOLE				3
+
+#define VIRTIO_STATUS_ACKNOWLEDGE		0x01
+#define VIRTIO_STATUS_DRIVER			0x02
+#define VIRTIO_STATUS_DRIVER_OK			0x04
+#define VIRTIO_STATUS_FEATURES_OK		0x08
+#define VIRTIO_STATUS_FAILED			0x80
+
+// Bit 0 of the second feature word (bit 32 overall)
+#define VIRTIO_F_VERSION_1				0x1
+
+// Port 0 receive queue is 0, transmit queue is 1 (no multiport)
+#define VIRTIO_CONSOLE_TX_QUEUE			1
+
+#define VIRTQ_DESC_F_NEXT				1
+#define VIRTQ_AVAIL_F_NO_INTERRUPT		1
+
+// Legacy transports locate the queue by page frame number, the used ring
+// starts at the next VIRTQ_ALIGN boundary after the available ring
+#define VIRTIO_PAGE_SIZE				4096
+#define VIRTQ_ALIGN						64
+
+#define QSIZE							VIRTIO_CONSOLE_QUEUE_SIZE
+
+struct virtq_desc {
+	uint64_t addr;
+	uint32_t len;
+	uint16_t flags;
+	uint16_t next;
+};
+
+struct virtq_avail {
+	uint16_t flags;
+	uint16_t idx;
+	uint16_t ring[QSIZE];
+	uint16_t used_event;
+};
+
+struct virtq_used_elem {
+	uint32_t id;
+	uint32_t len;
+};
+
+struct virtq_used {
+	uint16_t flags;
+	uint16_t idx;
+	struct virtq_used_elem ring[QSIZE];
+	uint16_t avail_event;
+};
+
+static struct {
+	struct virtq_desc desc[QSIZE];
+	struct virtq_avail avail;
+	struct virtq_used used __attribute__((aligned(VIRTQ_ALIGN)));
+} txq __attribute__((aligned(VIRTIO_PAGE_SIZE)));
+
+static uint8_t *dev = NULL;
+
+// Our copy of avail.idx, the device never writes it
+static uint16_t avail_idx = 0;
+
+/*-----------------------------------------------------------*/
+
+static int setup(uint8_t *base)
+{
+	uint32_t version = read32(base + VIRTIO_MMIO_VERSION);
+	uint32_t status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+	uint64_t addr = 0;
+
+	if(version != 1 && version != 2)
+		return -1;
+
+	write32(base + VIRTIO_MMIO_STATUS, 0);
+	write32(base + VIRTIO_MMIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+	write32(base + VIRTIO_MMIO_STATUS, status);
+
+	// None of the console features (size, multiport, emergency write)
+	write32(base + VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+	write32(base + VIRTIO_MMIO_DRIVER_FEATURES, 0);
+
+	if(version == 2){
+		write32(base + VIRTIO_MMIO_DEVICE_FEATURES_SEL, 1);
+		if(!(read32(base + VIRTIO_MMIO_DEVICE_FEATURES) & VIRTIO_F_VERSION_1))
+			goto fail;
+
+		write32(base + VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1);
+		write32(base + VIRTIO_MMIO_DRIVER_FEATURES, VIRTIO_F_VERSION_1);
+
+		status |= VIRTIO_STATUS_FEATURES_OK;
+		write32(base + VIRTIO_MMIO_STATUS, status);
+		if(!(read32(base + VIRTIO_MMIO_STATUS) & VIRTIO_STATUS_FEATURES_OK))
+			goto fail;
+	} else {
+		write32(base + VIRTIO_MMIO_GUEST_PAGE_SIZE, VIRTIO_PAGE_SIZE);
+	}
+
+	write32(base + VIRTIO_MMIO_QUEUE_SEL, VIRTIO_CONSOLE_TX_QUEUE);
+	if(read32(base + VIRTIO_MMIO_QUEUE_NUM_MAX) < QSIZE)
+		goto fail;
+
+	memset(&txq, 0, sizeof(txq));
+	avail_idx = 0;
+
+	// Completion is polled, interrupts would only cost another VM exit
+	txq.avail.flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+	write32(base + VIRTIO_MMIO_QUEUE_NUM, QSIZE);
+
+	if(version == 2){
+		addr = (uintptr_t) txq.desc;
+		write32(base + VIRTIO_MMIO_QUEUE_DESC_LOW, (uint32_t) addr);
+		write32(base + VIRTIO_MMIO_QUEUE_DESC_HIGH, (uint32_t) (addr >> 32));
+		addr = (uintptr_t) &txq.avail;
+		write32(base + VIRTIO_MMIO_QUEUE_DRIVER_LOW, (uint32_t) addr);
+		write32(base + VIRTIO_MMIO_QUEUE_DRIVER_HIGH, (uint32_t) (addr >> 32));
+		addr = (uintptr_t) &txq.used;
+		write32(base + VIRTIO_MMIO_QUEUE_DEVICE_LOW, (uint32_t) addr);
+		write32(base + VIRTIO_MMIO_QUEUE_DEVICE_HIGH, (uint32_t) (addr >> 32));
+		write32(base + VIRTIO_MMIO_QUEUE_READY, 1);
+	} else {
+		write32(base + VIRTIO_MMIO_QUEUE_ALIGN, VIRTQ_ALIGN);
+		write32(base + VIRTIO_MMIO_QUEUE_PFN, (uint32_t) ((uintptr_t) &txq / VIRTIO_PAGE_SIZE));
+	}
+
+	write32(base + VIRTIO_MMIO_STATUS, status | VIRTIO_STATUS_DRIVER_OK);
+
+	dev = base;
+	return 0;
+
+fail:
+	write32(base + VIRTIO_MMIO_STATUS, status | VIRTIO_STATUS_FAILED);
+	return -1;
+}
+
+int virtio_console_init(void)
+{
+	uint8_t *base = NULL;
+
+	for(uint32_t slot = 0; slot < VIRTIO_MMIO_SLOTS; slot++){
+		base = (uint8_t *) (VIRTIO_MMIO_ADDR + slot * VIRTIO_MMIO_STRIDE);
+
+		if(read32(base + VIRTIO_MMIO_MAGIC_VALUE) != VIRTIO_MAGIC ||
+		   read32(base + VIRTIO_MMIO_DEVICE_ID) != VIRTIO_ID_CONSOLE)
+			continue;
+
+		if(!setup(base))
+			return 0;
+	}
+
+	return -1;
+}
+
+int virtio_console_tx_done(void)
+{
+	if(*(volatile uint16_t *) &txq.used.idx != avail_idx)
+		return 0;
+
+	// The device is done reading, the buffers may be reused
+	__asm volatile("fence r, rw" ::: "memory");
+
+	return 1;
+}
+
+int virtio_console_send(const struct virtio_buf *bufs, uint32_t num)
+{
+	if(!dev || !num || num > QSIZE || !virtio_console_tx_done())
+		return -1;
+
+	// Only one chain is in flight, so it always starts at descriptor 0
+	for(uint32_t i = 0; i < num; i++){
+		txq.desc[i].addr = (uintptr_t) bufs[i].addr;
+		txq.desc[i].len = bufs[i].len;
+		txq.desc[i].flags = (i + 1 < num) ? VIRTQ_DESC_F_NEXT : 0;
+		txq.desc[i].next = (uint16_t) (i + 1);
+	}
+
+	txq.avail.ring[avail_idx % QSIZE] = 0;
+
+	// Descriptors and ring entry before the index, the index before the kick
+	__asm volatile("fence w, w" ::: "memory");
+	*(volatile uint16_t *) &txq.avail.idx = ++avail_idx;
+	__asm volatile("fence w, o" ::: "memory");
+
+	write32(dev + VIRTIO_MMIO_QUEUE_NOTIFY, VIRTIO_CONSOLE_TX_QUEUE);
+
+	return 0;
+}
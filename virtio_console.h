@@ -0,0 +1,43 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef VIRTIO_CONSOLE_H_
+#define VIRTIO_CONSOLE_H_
+
+#include <stdint.h>
+
+// Transmit-only virtio console on a virtio-mmio transport
+//
+// A whole chain of buffers is handed to the device with a single
+// QueueNotify write, i.e. one VM exit, instead of one trapped UART access
+// per byte. Legacy (version 1) and modern (version 2) transports are
+// supported. The device does not interrupt us, completion is polled with
+// virtio_console_tx_done().
+
+// Descriptors in the transmit queue, i.e. the longest chain that can be
+// sent at once. Must be a power of two.
+#ifndef VIRTIO_CONSOLE_QUEUE_SIZE
+#define VIRTIO_CONSOLE_QUEUE_SIZE	4
+#endif
+
+struct virtio_buf {
+	const void *addr;
+	uint32_t len;
+};
+
+// Look for a console device on the VIRTIO_MMIO_SLOTS transports starting at
+// VIRTIO_MMIO_ADDR and set up its transmit queue. Returns -1 if there is none.
+int virtio_console_init(void);
+
+// Send num buffers as one chain. The buffers must stay untouched until
+// virtio_console_tx_done() returns 1. Returns -1 if the device is missing
+// or still busy with the previous chain.
+int virtio_console_send(const struct virtio_buf *bufs, uint32_t num);
+
+// 1 once the device consumed the last chain
+int virtio_console_tx_done(void);
+
+#endif
@@ -0,0 +1,25 @@
+// Copyright 2023 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Christopher Reinwardt <creinwar@student.ethz.ch>
+
+#ifndef XORSHIFT_H_
+#define XORSHIFT_H_
+
+#include <stdint.h>
+
+// Marsaglia's xorshift64, good enough to shuffle pages and pick classes.
+// The state must not be zero.
+static inline uint64_t xorshift64(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+
+	return *state = x;
+}
+
+#endif /* XORSHIFT_H_ */